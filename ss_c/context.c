@@ -0,0 +1,64 @@
+#include "scheme.h"
+
+// 嵌入 API：把解释器包成可按线程实例化的库（libscheme.a）。
+// 可变状态（分配器、驻留池、GC、各引擎栈）全部是线程局部量，
+// S_Context 只是本线程那份解释器的句柄：创建即初始化全局环境并
+// 注册原语。各线程的上下文互不相干，宿主无需任何加锁；代价是
+// 对象和符号不可跨线程传递（各池互不相识）。
+
+_Thread_local S_Env *global_env = NULL;
+
+S_Context *scheme_context_new(void) {
+    if (global_env) { // 状态线程局部，一个线程只能有一个上下文
+        fprintf(stderr, "Error: thread already owns a context\n");
+        exit(1);
+    }
+    global_env = s_env_new(NULL);
+    init_primitives(global_env);
+    S_Context *ctx = malloc(sizeof(S_Context));
+    ctx->env = global_env;
+    ctx->last_result = NULL;
+    return ctx;
+}
+
+// simplify + 词法寻址 + 树遍历求值（嵌入方的单表达式入口）
+S_Object *scheme_context_eval(S_Context *ctx, S_Object *expr) {
+    (void)ctx; // 状态本就线程局部，句柄仅供 API 对称
+    expr = scheme_simplify(expr);
+    expr = scheme_resolve(expr);
+    return scheme_eval(expr, global_env);
+}
+
+// 逐个求值 src 中的 toplevel 形式，返回最后一个值；形式之间是 GC
+// 安全点。上一次调用的返回值（ctx->last_result）在本次调用的安全点
+// 上同样保活——宿主持有的返回值直到下一次 eval_string 返回并把根
+// 换成新结果时才失效，见 scheme.h 的生命周期说明
+S_Object *scheme_context_eval_string(S_Context *ctx, const char *src) {
+    FILE *fp = fmemopen((void*)src, strlen(src), "r");
+    if (!fp) {
+        perror("fmemopen");
+        exit(1);
+    }
+    S_Object *prev = ctx->last_result;
+    S_Object *expr, *result = NULL;
+    while ((expr = scheme_read(fp)) != NULL) {
+        result = scheme_context_eval(ctx, expr);
+        // 双根成对：当前中间结果 + 上一次调用的返回值（define 无值）
+        s_gc_roots = s_pair(result ? result : s_nil(),
+                            prev ? prev : s_nil());
+        s_gc_maybe_collect(); // 安全点：expr 已死亡
+    }
+    scheme_read_end(fp);
+    fclose(fp);
+    ctx->last_result = result;
+    s_gc_roots = result; // 此后只保新返回值
+    return result;
+}
+
+// 注销上下文。线程局部的 slab/驻留池保留给本线程复用：
+// 旧对象在下一个上下文的首次 GC 中不可达即被清扫
+void scheme_context_destroy(S_Context *ctx) {
+    scheme_write_flush();
+    global_env = NULL;
+    free(ctx);
+}
@@ -1,132 +1,522 @@
 #include "scheme.h"
 
-// 简单的引用计数，避免频繁的malloc/free
-void s_inc_ref(S_Object *obj) {
-    if (obj) obj->ref_count++;
-}
-
-void s_dec_ref(S_Object *obj) {
-    if (!obj) return;
-    obj->ref_count--;
-    if (obj->ref_count <= 0) {
-        // 递归释放
-        if (obj->type == S_SYMBOL && obj->val.sym_val) {
-            free(obj->val.sym_val);
-        } else if (obj->type == S_PAIR) {
-            s_dec_ref(obj->val.pair.car);
-            s_dec_ref(obj->val.pair.cdr);
-        } else if (obj->type == S_CLOSURE) {
-            s_dec_ref(obj->val.closure.params);
-            s_dec_ref(obj->val.closure.body);
-            // 环境不在这里释放，由其自身的生命周期管理
+// S_Object 专用 slab 分配器：从大块内存中按对象大小切分，
+// 分配只是指针递增（或弹出空闲链），相邻分配的 cons 单元在内存中也相邻。
+#define S_SLAB_OBJS 4096
+
+typedef struct S_Slab {
+    struct S_Slab *next;
+    S_Object objs[S_SLAB_OBJS];
+} S_Slab;
+
+// 解释器的可变状态一律线程局部：每个线程就是一个独立的解释器实例
+// （见 context.c），多线程嵌入零加锁，对象不跨线程传递。
+static _Thread_local S_Env *env_registry = NULL; // 所有环境帧，供 GC 清扫
+
+// 环境帧回收：死亡的内嵌存储帧按容量分桶缓存（借 parent 字段串链），
+// 下一轮 s_env_frame/s_env_new 直接弹出。对象本身早已经 obj_free_list
+// 回收，这样稳态求值中调用帧的分配也退化为几次指针操作。
+static _Thread_local S_Env *env_free_buckets[S_ENV_SMALL_CAP + 1];
+static _Thread_local size_t gc_alloc_count = 0; // 距上次 GC 的分配数
+#define GC_THRESHOLD 65536
+
+static _Thread_local S_Slab *slab_list = NULL;
+static _Thread_local int slab_used = S_SLAB_OBJS; // 当前 slab 已用数，触发首次分配
+static _Thread_local S_Object *obj_free_list = NULL; // 空闲对象链，借 pair.car 串联
+
+static S_Object *s_obj_alloc() {
+    gc_alloc_count++;
+    if (obj_free_list) {
+        S_Object *obj = obj_free_list;
+        obj_free_list = obj->val.pair.car;
+        return obj;
+    }
+    if (slab_used == S_SLAB_OBJS) {
+        S_Slab *slab = malloc(sizeof(S_Slab));
+        slab->next = slab_list;
+        slab_list = slab;
+        slab_used = 0;
+    }
+    return &slab_list->objs[slab_used++];
+}
+
+// ---- 标记-清扫 GC ----
+// 引用计数已退役：对象由 GC 统一回收。回收只发生在 toplevel 表达式
+// 之间的安全点（s_gc_maybe_collect），此时唯一的根是 global_env。
+
+// 标记用显式工作表而非 C 递归：百万元素的列表按 cdr 方向串起来时，
+// 逐格递归会压出同样深的 C 栈；工作表把遍历摊平成紧凑循环，
+// 栈容量跨次收集保留在高水位，稳态下不再 realloc。
+static _Thread_local S_Object **mark_stack = NULL;
+static _Thread_local size_t mark_len = 0, mark_cap = 0;
+
+static void mark_push(S_Object *obj) {
+    if (!obj || !s_is_heap(obj)) return; // 立即数无需标记
+    if (obj->gc_mark || obj->type == S_SYMBOL) return; // 符号常驻
+    obj->gc_mark = 1; // 入栈即标记，同一对象不会重复入栈
+    if (mark_len == mark_cap) {
+        mark_cap = mark_cap ? mark_cap * 2 : 1024;
+        mark_stack = realloc(mark_stack, mark_cap * sizeof(S_Object*));
+    }
+    mark_stack[mark_len++] = obj;
+}
+
+void s_gc_mark(S_Object *obj) {
+    mark_push(obj);
+    while (mark_len) {
+        S_Object *o = mark_stack[--mark_len];
+        switch (o->type) {
+            case S_PAIR:
+                mark_push(o->val.pair.car);
+                mark_push(o->val.pair.cdr);
+                break;
+            case S_CLOSURE:
+            case S_VMCLOSURE: {
+                mark_push(o->val.closure.params);
+                if (o->type == S_CLOSURE) {
+                    mark_push(o->val.closure.body);
+                } else {
+                    // chunk 标记内部经 s_gc_mark 重入，共享同一工作表
+                    scheme_vm_mark_chunk(o->val.closure.body);
+                }
+                S_Env *env = o->val.closure.env;
+                for (; env && !env->gc_mark; env = env->parent) {
+                    env->gc_mark = 1;
+                    for (int i = 0; i < env->cap; i++) {
+                        if (env->syms[i]) mark_push(env->vals[i]);
+                    }
+                }
+                break;
+            }
+            case S_MEMO: {
+                mark_push(o->val.memo.proc);
+                // 缓存键全是立即数，只需标记缓存的结果值
+                S_MemoCache *mc = o->val.memo.cache;
+                for (size_t i = 0; i < mc->cap; i++) {
+                    for (S_MemoEntry *e = mc->buckets[i]; e; e = e->next) {
+                        mark_push(e->value);
+                    }
+                }
+                break;
+            }
+            default:
+                break; // localref/globalref 只引用常驻符号
+        }
+    }
+}
+
+// 释放备忘缓存（包装对象被清扫时调用）
+static void memo_cache_free(S_MemoCache *mc) {
+    for (size_t i = 0; i < mc->cap; i++) {
+        S_MemoEntry *e = mc->buckets[i];
+        while (e) {
+            S_MemoEntry *next = e->next;
+            free(e->args);
+            free(e);
+            e = next;
         }
-        free(obj);
     }
+    free(mc->buckets);
+    free(mc);
 }
 
-// 创建 Scheme 对象
+static void gc_mark_env(S_Env *env) {
+    for (; env && !env->gc_mark; env = env->parent) {
+        env->gc_mark = 1;
+        for (int i = 0; i < env->cap; i++) {
+            if (env->syms[i]) s_gc_mark(env->vals[i]);
+        }
+    }
+}
+
+_Thread_local S_Object *s_gc_roots = NULL; // 额外根：镜像载入后尚未执行的形式链
+
+void s_gc_collect(void) {
+    gc_mark_env(global_env);
+    s_gc_mark(s_gc_roots);
+
+    // 回收桶按轮重建：上一轮缓存、这一轮仍未被取用的帧是过剩供给
+    //（批处理脚本中帧密集的表达式会留下成千上万个），先归还 malloc，
+    // 本轮清扫再按实际死亡量重新填桶——留存量自动贴合稳态需求
+    for (int b = 0; b <= S_ENV_SMALL_CAP; b++) {
+        S_Env *e = env_free_buckets[b];
+        while (e) {
+            S_Env *next = e->parent;
+            free(e);
+            e = next;
+        }
+        env_free_buckets[b] = NULL;
+    }
+
+    // 清扫环境帧
+    S_Env **elink = &env_registry;
+    while (*elink) {
+        S_Env *env = *elink;
+        if (env->gc_mark) {
+            env->gc_mark = 0;
+            elink = &env->gc_next;
+        } else {
+            *elink = env->gc_next;
+            if (env->syms == NULL ||
+                (env->syms == (S_Object**)(env + 1) &&
+                 env->cap <= S_ENV_SMALL_CAP)) {
+                // 未扩容的小帧进回收桶，容量即 s_env_frame 的块大小
+                int b = env->syms ? env->cap : 0;
+                env->parent = env_free_buckets[b];
+                env_free_buckets[b] = env;
+            } else {
+                // 扩容过的帧块大小已不可知，连同分离的存储一起释放
+                if (env->syms != (S_Object**)(env + 1)) {
+                    free(env->syms);
+                    free(env->vals);
+                }
+                free(env);
+            }
+        }
+    }
+
+    // 清扫对象 slab：头部 slab 只用到 slab_used，其余已满。
+    // 空闲链同样按轮重建：逐 slab 统计存活，整块皆空的 slab 一次
+    // free 归还——一个表达式造出再多垃圾，收尾也只是按块释放，
+    // 表达式之间的驻留内存回落到活数据的量级
+    obj_free_list = NULL;
+    S_Slab *head = slab_list;
+    int used = slab_used;
+    S_Slab **slink = &slab_list;
+    while (*slink) {
+        S_Slab *slab = *slink;
+        int live = 0;
+        S_Object *local = NULL, *local_tail = NULL;
+        for (int i = 0; i < used; i++) {
+            S_Object *obj = &slab->objs[i];
+            if (obj->type == S_SYMBOL) { // 符号常驻，slab 随之常驻
+                live++;
+                continue;
+            }
+            if (obj->gc_mark) {
+                obj->gc_mark = 0;
+                live++;
+                continue;
+            }
+            if (obj->type == S_VECTOR) free(obj->val.vec.data);
+            else if (obj->type == S_MEMO) memo_cache_free(obj->val.memo.cache);
+            obj->type = S_FREE;
+            obj->val.pair.car = local;
+            if (!local) local_tail = obj;
+            local = obj;
+        }
+        used = S_SLAB_OBJS;
+        if (live == 0) {
+            *slink = slab->next;
+            free(slab);
+        } else {
+            if (local) { // 本 slab 的空闲对象接回全局空闲链
+                local_tail->val.pair.car = obj_free_list;
+                obj_free_list = local;
+            }
+            slink = &slab->next;
+        }
+    }
+    // 头 slab 被整块释放后，存活的 slab 都已填满，恢复哨兵触发新分配
+    if (slab_list != head) slab_used = S_SLAB_OBJS;
+    gc_alloc_count = 0;
+}
+
+void s_gc_maybe_collect(void) {
+    if (gc_alloc_count >= GC_THRESHOLD) s_gc_collect();
+}
+
+// 创建 Scheme 对象：数字和布尔是立即数，没有堆分配。
+// 整数值规范化为定点编码，同值必同码（指针比较即值比较）
 S_Object *s_number(double num) {
-    S_Object *obj = malloc(sizeof(S_Object));
-    obj->type = S_NUMBER;
-    obj->val.num_val = num;
-    obj->ref_count = 0;
-    return obj;
+    if (num >= (double)S_FIX_MIN && num < (double)S_FIX_MAX) {
+        int64_t i = (int64_t)num;
+        if ((double)i == num) return s_fixnum(i);
+    }
+    union { double d; uint64_t u; } c;
+    c.d = num;
+    if (num != num) c.u = 0x7FF8000000000000ULL; // 规范化 NaN，避免回绕
+    return (S_Object*)(c.u + S_NUM_OFFSET);
+}
+
+S_Object *s_int(int64_t v) {
+    if (v >= S_FIX_MIN && v < S_FIX_MAX) return s_fixnum(v);
+    return s_number((double)v);
 }
 
 S_Object *s_bool(int b) {
-    S_Object *obj = malloc(sizeof(S_Object));
-    obj->type = S_BOOL;
-    obj->val.bool_val = b;
-    obj->ref_count = 0;
-    return obj;
+    return b ? S_TRUE_V : S_FALSE_V;
+}
+
+// 符号驻留池：同名符号全局唯一，环境查找只需比较指针
+static _Thread_local S_Object **intern_table = NULL;
+static _Thread_local size_t intern_cap = 0;
+static _Thread_local size_t intern_count = 0;
+
+static size_t intern_hash(const char *s) {
+    // FNV-1a
+    size_t h = 1469598103934665603UL;
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 1099511628211UL;
+    }
+    return h;
+}
+
+static void intern_grow() {
+    size_t old_cap = intern_cap;
+    S_Object **old = intern_table;
+    intern_cap = old_cap ? old_cap * 2 : 64;
+    intern_table = calloc(intern_cap, sizeof(S_Object*));
+    for (size_t j = 0; j < old_cap; j++) {
+        if (!old[j]) continue;
+        size_t i = intern_hash(s_sym_name(old[j])) & (intern_cap - 1);
+        while (intern_table[i]) i = (i + 1) & (intern_cap - 1);
+        intern_table[i] = old[j];
+    }
+    free(old);
 }
 
 S_Object *s_symbol(const char *sym) {
-    S_Object *obj = malloc(sizeof(S_Object));
+    if (intern_count * 4 >= intern_cap * 3) intern_grow();
+    size_t i = intern_hash(sym) & (intern_cap - 1);
+    while (intern_table[i]) {
+        if (strcmp(s_sym_name(intern_table[i]), sym) == 0) {
+            return intern_table[i];
+        }
+        i = (i + 1) & (intern_cap - 1);
+    }
+    static const struct { const char *name; int id; } specials[] = {
+        { "if", S_SF_IF }, { "define", S_SF_DEFINE }, { "lambda", S_SF_LAMBDA },
+        { "and", S_SF_AND }, { "or", S_SF_OR },
+    };
+    if (s_profile_on) s_profile.alloc_by_type[S_SYMBOL]++;
+    S_Object *obj = s_obj_alloc();
     obj->type = S_SYMBOL;
-    obj->val.sym_val = strdup(sym);
-    obj->ref_count = 0;
+    obj->val.sym.name = strdup(sym);
+    obj->val.sym.special = S_SF_NONE;
+    obj->gc_mark = 0;
+    for (size_t k = 0; k < sizeof(specials) / sizeof(specials[0]); k++) {
+        if (strcmp(sym, specials[k].name) == 0) {
+            obj->val.sym.special = specials[k].id;
+            break;
+        }
+    }
+    intern_table[i] = obj;
+    intern_count++;
     return obj;
 }
 
 S_Object *s_pair(S_Object *car, S_Object *cdr) {
-    S_Object *obj = malloc(sizeof(S_Object));
+    if (s_profile_on) s_profile.alloc_by_type[S_PAIR]++;
+    S_Object *obj = s_obj_alloc();
     obj->type = S_PAIR;
     obj->val.pair.car = car;
     obj->val.pair.cdr = cdr;
-    s_inc_ref(car);
-    s_inc_ref(cdr);
-    obj->ref_count = 0;
+    obj->gc_mark = 0;
     return obj;
 }
 
-S_Object *s_proc(S_Object* (*proc)(S_Object*)) {
-    S_Object *obj = malloc(sizeof(S_Object));
+S_Object *s_proc(const S_PrimDesc *desc) {
+    if (s_profile_on) s_profile.alloc_by_type[S_PROC]++;
+    S_Object *obj = s_obj_alloc();
     obj->type = S_PROC;
-    obj->val.prim_proc = proc;
-    obj->ref_count = 0;
+    obj->val.prim = desc;
+    obj->gc_mark = 0;
     return obj;
 }
 
-S_Object *s_closure(S_Object *params, S_Object *body, S_Object *env) {
-    S_Object *obj = malloc(sizeof(S_Object));
+S_Object *s_closure(S_Object *params, S_Object *body, S_Env *env) {
+    if (s_profile_on) s_profile.alloc_by_type[S_CLOSURE]++;
+    S_Object *obj = s_obj_alloc();
     obj->type = S_CLOSURE;
     obj->val.closure.params = params;
     obj->val.closure.body = body;
     obj->val.closure.env = env; // 不增加引用，环境由外部管理
-    s_inc_ref(params);
-    s_inc_ref(body);
-    obj->ref_count = 0;
+    obj->gc_mark = 0;
+    return obj;
+}
+
+S_Object *s_vector(int len) {
+    if (s_profile_on) s_profile.alloc_by_type[S_VECTOR]++;
+    S_Object *obj = s_obj_alloc();
+    obj->type = S_VECTOR;
+    obj->val.vec.len = len;
+    obj->val.vec.data = calloc(len, sizeof(double));
+    obj->gc_mark = 0;
+    return obj;
+}
+
+#define S_MEMO_INIT_CAP 64
+
+S_Object *s_memo(S_Object *proc) {
+    if (s_profile_on) s_profile.alloc_by_type[S_MEMO]++;
+    S_Object *obj = s_obj_alloc();
+    obj->type = S_MEMO;
+    obj->val.memo.proc = proc;
+    S_MemoCache *mc = malloc(sizeof(S_MemoCache));
+    mc->cap = S_MEMO_INIT_CAP;
+    mc->count = 0;
+    mc->buckets = calloc(mc->cap, sizeof(S_MemoEntry*));
+    obj->val.memo.cache = mc;
+    obj->gc_mark = 0;
     return obj;
 }
 
 S_Object *s_nil() {
-    static S_Object nil_obj = { .type = S_NIL };
-    return &nil_obj;
+    return S_NIL_V;
 }
 
 // 环境管理
 S_Env *s_env_new(S_Env *parent) {
-    S_Env *env = malloc(sizeof(S_Env));
-    env->bindings = s_nil();
+    if (s_profile_on) s_profile.env_frames++;
+    S_Env *env;
+    if (env_free_buckets[0]) { // 无内嵌存储的帧与 0 容量帧同大小
+        env = env_free_buckets[0];
+        env_free_buckets[0] = env->parent;
+    } else {
+        env = malloc(sizeof(S_Env));
+    }
+    env->syms = NULL;
+    env->vals = NULL;
+    env->count = 0;
+    env->cap = 0;
     env->parent = parent;
+    env->gc_next = env_registry;
+    env->gc_mark = 0;
+    env->version = 0;
+    env_registry = env;
+    gc_alloc_count++;
     return env;
 }
 
-S_Object *s_env_find(S_Env *env, const char *sym) {
-    S_Object *p = env->bindings;
-    while (p->type != S_NIL) {
-        S_Object *binding = p->val.pair.car;
-        if (binding->type == S_PAIR &&
-            binding->val.pair.car->type == S_SYMBOL &&
-            strcmp(binding->val.pair.car->val.sym_val, sym) == 0) {
-            return binding->val.pair.cdr;
+// 调用帧快速路径：头部和 syms/vals 存储一次 malloc 带出（紧跟结构体
+// 之后），槽位由调用方按参数位置顺序填充，与词法寻址的 index 一致。
+// 仅限 n <= S_ENV_SMALL_CAP 的线性帧；大帧仍走 s_env_new + s_env_bind。
+S_Env *s_env_frame(S_Env *parent, int n) {
+    if (s_profile_on) s_profile.env_frames++;
+    S_Env *env;
+    if (env_free_buckets[n]) {
+        env = env_free_buckets[n];
+        env_free_buckets[n] = env->parent;
+    } else {
+        env = malloc(sizeof(S_Env) + 2 * n * sizeof(S_Object*));
+    }
+    env->syms = (S_Object**)(env + 1);
+    env->vals = env->syms + n;
+    env->count = 0;
+    env->cap = n;
+    env->parent = parent;
+    env->gc_next = env_registry;
+    env->gc_mark = 0;
+    env->version = 0;
+    env_registry = env;
+    gc_alloc_count++;
+    return env;
+}
+
+// 驻留符号的指针哈希（Fibonacci 散列）
+static size_t env_hash(S_Object *sym) {
+    return ((size_t)sym >> 4) * 11400714819323198485UL;
+}
+
+// 在哈希模式的帧中定位 sym 的槽位（或第一个空槽）
+static int env_probe(S_Env *env, S_Object *sym) {
+    size_t i = env_hash(sym) & (env->cap - 1);
+    while (env->syms[i] && env->syms[i] != sym) {
+        i = (i + 1) & (env->cap - 1);
+    }
+    return (int)i;
+}
+
+// 扩容：小帧翻倍仍线性；超过阈值后改为哈希布局重新插入
+static void env_grow(S_Env *env) {
+    env->version++; // 槽位重排，失效内联缓存
+    int old_cap = env->cap;
+    S_Object **old_syms = env->syms;
+    S_Object **old_vals = env->vals;
+    env->cap = old_cap ? old_cap * 2 : 4;
+    env->syms = calloc(env->cap, sizeof(S_Object*));
+    env->vals = calloc(env->cap, sizeof(S_Object*));
+    for (int j = 0; j < old_cap; j++) {
+        if (!old_syms[j]) continue;
+        int i = (env->cap <= S_ENV_SMALL_CAP) ? j : env_probe(env, old_syms[j]);
+        env->syms[i] = old_syms[j];
+        env->vals[i] = old_vals[j];
+    }
+    if (old_syms != (S_Object**)(env + 1)) { // 内嵌存储随帧释放，此处不 free
+        free(old_syms);
+        free(old_vals);
+    }
+}
+
+// 只在本帧内查找 sym，返回槽下标；不存在返回 -1（内联缓存用）
+int s_env_slot(S_Env *env, S_Object *sym) {
+    if (env->cap <= S_ENV_SMALL_CAP) {
+        for (int i = 0; i < env->count; i++) {
+            if (env->syms[i] == sym) return i;
         }
-        p = p->val.pair.cdr;
+        return -1;
     }
-    if (env->parent) {
-        return s_env_find(env->parent, sym);
+    int i = env_probe(env, sym);
+    return env->syms[i] ? i : -1;
+}
+
+// 剖析：记录一次在第 depth 层命中的变量查找
+static void prof_lookup(int depth) {
+    s_profile.lookups++;
+    if (depth >= S_PROF_DEPTH_BUCKETS) depth = S_PROF_DEPTH_BUCKETS - 1;
+    s_profile.lookup_depth[depth]++;
+}
+
+S_Object *s_env_find(S_Env *env, S_Object *sym) {
+    int depth = 0;
+    while (env) {
+        if (env->cap <= S_ENV_SMALL_CAP) { // 线性模式
+            for (int i = 0; i < env->count; i++) {
+                if (env->syms[i] == sym) {
+                    if (s_profile_on) prof_lookup(depth);
+                    return env->vals[i];
+                }
+            }
+        } else { // 哈希模式
+            int i = env_probe(env, sym);
+            if (env->syms[i]) {
+                if (s_profile_on) prof_lookup(depth);
+                return env->vals[i];
+            }
+        }
+        env = env->parent;
+        depth++;
     }
-    fprintf(stderr, "Error: unbound variable '%s'\n", sym);
+    fprintf(stderr, "Error: unbound variable '%s'\n", s_sym_name(sym));
     exit(1);
 }
 
-void s_env_bind(S_Env *env, const char *sym, S_Object *val) {
-    S_Object *p = env->bindings;
-    while (p->type != S_NIL) {
-        S_Object *binding = p->val.pair.car;
-        if (binding->type == S_PAIR &&
-            binding->val.pair.car->type == S_SYMBOL &&
-            strcmp(binding->val.pair.car->val.sym_val, sym) == 0) {
-            s_dec_ref(binding->val.pair.cdr);
-            binding->val.pair.cdr = val;
-            s_inc_ref(val);
+void s_env_bind(S_Env *env, S_Object *sym, S_Object *val) {
+    if (env->cap <= S_ENV_SMALL_CAP) {
+        for (int i = 0; i < env->count; i++) {
+            if (env->syms[i] == sym) {
+                env->vals[i] = val;
+                return;
+            }
+        }
+        if (env->count == env->cap) env_grow(env);
+        if (env->cap <= S_ENV_SMALL_CAP) {
+            env->syms[env->count] = sym;
+            env->vals[env->count] = val;
+            env->count++;
             return;
         }
-        p = p->val.pair.cdr;
+        // env_grow 已提升为哈希模式，落到下面插入
+    }
+    int i = env_probe(env, sym);
+    if (env->syms[i]) {
+        env->vals[i] = val;
+        return;
     }
-    S_Object *new_binding = s_pair(s_symbol(sym), val);
-    env->bindings = s_pair(new_binding, env->bindings);
-    s_inc_ref(new_binding);
-    s_inc_ref(val);
+    env->syms[i] = sym;
+    env->vals[i] = val;
+    env->count++;
+    if (env->count * 4 >= env->cap * 3) env_grow(env); // 负载因子 3/4
 }
\ No newline at end of file
@@ -1,131 +1,375 @@
 #include "scheme.h"
 
-// 辅助函数：将列表转换为C数组
-static S_Object **list_to_array(S_Object *list, int *len) {
-    int count = 0;
-    S_Object *p = list;
-    while (p->type != S_NIL) {
-        count++;
-        p = p->val.pair.cdr;
+// 求值器拥有的参数栈：原语实参求值后连续压在这里，按 (argv, argc)
+// 传给原语。嵌套调用（实参求值中又调用原语）靠基址下标隔离，
+// 容量跨调用保留在高水位，稳态下零分配。
+static _Thread_local S_Object **arg_stack = NULL;
+static _Thread_local size_t arg_top = 0, arg_stack_cap = 0;
+
+static void arg_push(S_Object *v) {
+    if (arg_top == arg_stack_cap) {
+        arg_stack_cap = arg_stack_cap ? arg_stack_cap * 2 : 256;
+        arg_stack = realloc(arg_stack, arg_stack_cap * sizeof(S_Object*));
+    }
+    arg_stack[arg_top++] = v;
+}
+
+// 原语回调用户过程（vector-map 等）的一次非尾位置应用，
+// 按过程种类分发到对应引擎
+S_Object *scheme_apply(S_Object *proc, S_Object **argv, int argc) {
+    if (s_type(proc) == S_PROC) {
+        const S_PrimDesc *d = proc->val.prim;
+        s_prim_check_arity(d, argc);
+        if (s_profile_on) s_profile_prim(d->fn);
+        if (argc == 2 && d->fn2) return d->fn2(argv[0], argv[1]);
+        return d->fn(argv, argc);
+    }
+    if (s_type(proc) == S_VMCLOSURE) {
+        return scheme_vm_apply(proc, argv, argc);
     }
-    *len = count;
-    S_Object **arr = malloc(count * sizeof(S_Object*));
-    p = list;
-    int i = 0;
-    while (p->type != S_NIL) {
-        arr[i++] = p->val.pair.car;
-        p = p->val.pair.cdr;
+    if (s_type(proc) == S_MEMO) {
+        return s_memo_call(proc, argv, argc);
+    }
+    if (s_type(proc) != S_CLOSURE) {
+        fprintf(stderr, "Error: not a procedure\n");
+        exit(1);
+    }
+
+    S_Object *params = proc->val.closure.params;
+    int n = 0;
+    for (S_Object *q = params; s_type(q) != S_NIL; q = s_cdr(q)) n++;
+
+    S_Env *new_env;
+    if (n <= S_ENV_SMALL_CAP) {
+        new_env = s_env_frame(proc->val.closure.env, n);
+        int i = 0;
+        for (S_Object *q = params; s_type(q) != S_NIL && i < argc;
+             q = s_cdr(q), i++) {
+            new_env->syms[i] = s_car(q);
+            new_env->vals[i] = argv[i];
+        }
+        new_env->count = i;
+        // 实参不足时清空余下槽位：回收帧残留的陈旧指针会被 GC 标记误走
+        for (; i < n; i++) new_env->syms[i] = NULL;
+    } else {
+        new_env = s_env_new(proc->val.closure.env);
+        int i = 0;
+        for (S_Object *q = params; s_type(q) != S_NIL && i < argc;
+             q = s_cdr(q), i++) {
+            s_env_bind(new_env, s_car(q), argv[i]);
+        }
     }
-    return arr;
+    return scheme_eval(proc->val.closure.body, new_env);
 }
 
+// ---- 显式续延栈 ----
+// 非尾递归不再消耗 C 栈：每个"子表达式求完后接着做什么"记成一个
+// K_Frame，压在堆上的连续数组里。深度只受内存限制，压/弹帧是几次
+// 寄存器/内存写，溢出时报错退出而非段错误。原语回调用户过程
+//（scheme_apply）会重入 scheme_eval，嵌套调用从进入时的水位之上
+// 使用同一条栈（与 VM 的共享栈约定一致）。
+
+enum {
+    K_IF,     // a=真分支 b=假分支
+    K_DEFINE, // a=符号
+    K_AND,    // a=剩余项
+    K_OR,     // a=剩余项
+    K_APP     // a=剩余实参，proc=算子（未求出为 NULL），base=参数栈基址
+};
+
+typedef struct {
+    int kind;
+    S_Object *a, *b;
+    S_Object *proc;
+    S_Env *env;
+    size_t base;
+} K_Frame;
+
+#define K_STACK_MAX (1 << 24) // 帧数上限，约 768MB；到顶即报错
+
+static _Thread_local K_Frame *k_stack = NULL;
+static _Thread_local size_t k_top = 0, k_cap = 0;
+
+static K_Frame *k_push(int kind, S_Env *env) {
+    if (k_top == k_cap) {
+        if (k_cap >= K_STACK_MAX) {
+            fprintf(stderr, "Error: recursion too deep\n");
+            exit(1);
+        }
+        k_cap = k_cap ? k_cap * 2 : 1024;
+        k_stack = realloc(k_stack, k_cap * sizeof(K_Frame));
+    }
+    K_Frame *f = &k_stack[k_top++];
+    f->kind = kind;
+    f->env = env;
+    return f;
+}
+
+// 求值主循环：尾位置（if 的分支、闭包应用的函数体）原地置换
+// expr/env，不压帧；其余子表达式求值压 K_Frame，值就绪后在
+// apply_k 处续延。整个函数只占一个 C 栈帧。
 S_Object *scheme_eval(S_Object *expr, S_Env *env) {
-    if (!expr) return s_nil();
-    
-    switch (expr->type) {
+    size_t k_base = k_top; // 重入隔离：本次调用只消费自己压的帧
+    S_Object *val;
+
+eval_loop:
+    if (!expr) {
+        val = s_nil();
+        goto apply_k;
+    }
+
+    if (s_profile_on) s_profile.eval_by_type[s_type(expr)]++;
+
+    switch (s_type(expr)) {
         case S_NUMBER:
         case S_BOOL:
         case S_PROC:
         case S_CLOSURE:
-            return expr;
-            
+        case S_VECTOR:
+        case S_MEMO:
+            val = expr;
+            goto apply_k;
+
         case S_SYMBOL:
-            return s_env_find(env, expr->val.sym_val);
-            
+            val = s_env_find(env, expr);
+            goto apply_k;
+
+        case S_LOCALREF: { // 词法寻址：直达第 depth 层帧的第 index 槽
+            S_Env *e = env;
+            for (int d = expr->val.localref.depth; d > 0; d--) e = e->parent;
+            val = e->vals[expr->val.localref.index];
+            goto apply_k;
+        }
+
+        case S_GLOBALREF: { // 内联缓存：版本吻合则直达全局值槽
+            if (expr->val.gref.slot >= 0 &&
+                expr->val.gref.version == global_env->version) {
+                val = global_env->vals[expr->val.gref.slot];
+                goto apply_k;
+            }
+            int slot = s_env_slot(global_env, expr->val.gref.sym);
+            if (slot < 0) {
+                fprintf(stderr, "Error: unbound variable '%s'\n",
+                        s_sym_name(expr->val.gref.sym));
+                exit(1);
+            }
+            expr->val.gref.slot = slot;
+            expr->val.gref.version = global_env->version;
+            val = global_env->vals[slot];
+            goto apply_k;
+        }
+
         case S_PAIR: {
-            S_Object *proc = expr->val.pair.car;
-            S_Object *args = expr->val.pair.cdr;
-            
-            if (proc->type == S_SYMBOL) {
-                if (strcmp(proc->val.sym_val, "if") == 0) {
-                    S_Object *test = args->val.pair.car;
-                    S_Object *conseq = args->val.pair.cdr->val.pair.car;
-                    S_Object *alt = args->val.pair.cdr->val.pair.cdr->val.pair.car;
-                    
-                    if (scheme_eval(test, env)->val.bool_val != 0) {
-                        return scheme_eval(conseq, env);
-                    } else {
-                        return scheme_eval(alt, env);
-                    }
-                }
-                if (strcmp(proc->val.sym_val, "define") == 0) {
-                    S_Object *sym = args->val.pair.car;
-                    S_Object *val_expr = args->val.pair.cdr->val.pair.car;
-                    S_Object *val = scheme_eval(val_expr, env);
-                    s_env_bind(env, sym->val.sym_val, val);
-                    return s_nil();
+            S_Object *proc = s_car(expr);
+            S_Object *args = s_cdr(expr);
+
+            // 特殊形式：驻留时已判定关键字 ID，整数 switch 分发
+            if (s_type(proc) == S_SYMBOL && s_sym_special(proc) != S_SF_NONE) {
+                switch (s_sym_special(proc)) {
+                case S_SF_IF: {
+                    K_Frame *f = k_push(K_IF, env);
+                    f->a = s_car(s_cdr(args));
+                    f->b = s_car(s_cdr(s_cdr(args)));
+                    expr = s_car(args);
+                    goto eval_loop;
                 }
-                if (strcmp(proc->val.sym_val, "lambda") == 0) {
-                    S_Object *params = args->val.pair.car;
-                    S_Object *body = args->val.pair.cdr->val.pair.car;
-                    return s_closure(params, body, env);
+                case S_SF_DEFINE: {
+                    K_Frame *f = k_push(K_DEFINE, env);
+                    f->a = s_car(args);
+                    expr = s_car(s_cdr(args));
+                    goto eval_loop;
                 }
-                if (strcmp(proc->val.sym_val, "and") == 0) {
-                    S_Object *p = args;
-                    while (p->type != S_NIL) {
-                        S_Object *res = scheme_eval(p->val.pair.car, env);
-                        if (res->type == S_BOOL && res->val.bool_val == 0) {
-                            return s_bool(0);
+                case S_SF_LAMBDA: {
+                    S_Object *params = s_car(args);
+                    S_Object *body = s_car(s_cdr(args));
+                    S_Object *rest = s_cdr(s_cdr(args));
+                    if (s_type(rest) != S_NIL) {
+                        // 捕获裁剪（resolve.c）：按捕获表快照自由变量到
+                        // 扁平帧，父帧直指全局，不再挂住整条定义链
+                        S_Object *caps = s_car(rest);
+                        int n = 0;
+                        for (S_Object *p = caps; s_type(p) != S_NIL; p = s_cdr(p)) n++;
+                        if (n == 0) {
+                            val = s_closure(params, body, global_env);
+                            goto apply_k;
+                        }
+                        S_Env *cap_env = s_env_frame(global_env, n);
+                        int i = 0;
+                        for (S_Object *p = caps; s_type(p) != S_NIL;
+                             p = s_cdr(p), i++) {
+                            S_Object *ref = s_car(p);
+                            S_Env *e = env;
+                            for (int d = ref->val.localref.depth; d > 0; d--) {
+                                e = e->parent;
+                            }
+                            cap_env->syms[i] = ref->val.localref.sym;
+                            cap_env->vals[i] = e->vals[ref->val.localref.index];
                         }
-                        p = p->val.pair.cdr;
+                        cap_env->count = n;
+                        val = s_closure(params, body, cap_env);
+                        goto apply_k;
                     }
-                    return s_bool(1);
+                    val = s_closure(params, body, env);
+                    goto apply_k;
                 }
-                if (strcmp(proc->val.sym_val, "or") == 0) {
-                    S_Object *p = args;
-                    while (p->type != S_NIL) {
-                        S_Object *res = scheme_eval(p->val.pair.car, env);
-                        if (res->type == S_BOOL && res->val.bool_val != 0) {
-                            return s_bool(1);
-                        }
-                        p = p->val.pair.cdr;
+                case S_SF_AND: {
+                    if (s_type(args) == S_NIL) {
+                        val = S_TRUE_V;
+                        goto apply_k;
                     }
-                    return s_bool(0);
+                    K_Frame *f = k_push(K_AND, env);
+                    f->a = s_cdr(args);
+                    expr = s_car(args);
+                    goto eval_loop;
                 }
+                case S_SF_OR: {
+                    if (s_type(args) == S_NIL) {
+                        val = S_FALSE_V;
+                        goto apply_k;
+                    }
+                    K_Frame *f = k_push(K_OR, env);
+                    f->a = s_cdr(args);
+                    expr = s_car(args);
+                    goto eval_loop;
+                }
+                }
+            }
+
+            // 函数应用：先求算子，再依次求实参（压上参数栈）
+            K_Frame *f = k_push(K_APP, env);
+            f->a = args;
+            f->proc = NULL;
+            f->base = arg_top;
+            expr = proc;
+            goto eval_loop;
+        }
+        default:
+            fprintf(stderr, "Error: invalid expression\n");
+            exit(1);
+    }
+
+apply_k:
+    if (k_top == k_base) return val; // 本次调用的帧耗尽，val 即结果
+    {
+        K_Frame *f = &k_stack[k_top - 1];
+        switch (f->kind) {
+        case K_IF:
+            k_top--;
+            expr = s_is_true(val) ? f->a : f->b; // 分支在尾位置
+            env = f->env;
+            goto eval_loop;
+
+        case K_DEFINE:
+            k_top--;
+            s_env_bind(f->env, f->a, val);
+            val = NULL; // define 不产生值
+            goto apply_k;
+
+        case K_AND:
+            if (!s_is_true(val)) {
+                k_top--;
+                val = S_FALSE_V;
+                goto apply_k;
             }
+            if (s_type(f->a) == S_NIL) {
+                k_top--;
+                val = S_TRUE_V;
+                goto apply_k;
+            }
+            expr = s_car(f->a);
+            f->a = s_cdr(f->a);
+            env = f->env;
+            goto eval_loop;
 
-            // 函数应用
-            S_Object *proc_obj = scheme_eval(proc, env);
-            if (proc_obj->type != S_PROC && proc_obj->type != S_CLOSURE) {
+        case K_OR:
+            if (s_is_true(val)) {
+                k_top--;
+                val = S_TRUE_V;
+                goto apply_k;
+            }
+            if (s_type(f->a) == S_NIL) {
+                k_top--;
+                val = S_FALSE_V;
+                goto apply_k;
+            }
+            expr = s_car(f->a);
+            f->a = s_cdr(f->a);
+            env = f->env;
+            goto eval_loop;
+
+        case K_APP: {
+            if (!f->proc) f->proc = val; // 先到的是算子
+            else arg_push(val);
+            if (s_type(f->a) == S_PAIR) { // 还有实参待求
+                expr = s_car(f->a);
+                f->a = s_cdr(f->a);
+                env = f->env;
+                goto eval_loop;
+            }
+
+            // 实参齐备。原语可能重入本函数并让 k_stack 扩容搬家，
+            // f 随即失效：先把要跨调用使用的字段拷到局部
+            S_Object *proc_obj = f->proc;
+            size_t base = f->base;
+            int n = (int)(arg_top - base);
+            S_Object **argv = &arg_stack[base];
+            int pt = s_type(proc_obj);
+
+            if (pt == S_PROC) {
+                const S_PrimDesc *d = proc_obj->val.prim;
+                s_prim_check_arity(d, n);
+                if (s_profile_on) s_profile_prim(d->fn);
+                // 二元快路径：fn2 直调，实参留在寄存器里
+                val = (n == 2 && d->fn2) ? d->fn2(argv[0], argv[1])
+                                         : d->fn(argv, n);
+                arg_top = base;
+                k_top--;
+                goto apply_k;
+            }
+            if (pt == S_MEMO) { // 先查缓存，未命中才经 scheme_apply 应用
+                val = s_memo_call(proc_obj, argv, n);
+                arg_top = base;
+                k_top--;
+                goto apply_k;
+            }
+            if (pt != S_CLOSURE) {
                 fprintf(stderr, "Error: not a procedure\n");
                 exit(1);
             }
 
-            S_Object *evaled_args = s_nil();
-            S_Object **tail = &evaled_args;
-            S_Object *p = args;
-            while (p->type != S_NIL) {
-                S_Object *arg = scheme_eval(p->val.pair.car, env);
-                S_Object *pair = s_pair(arg, s_nil());
-                *tail = pair;
-                tail = &pair->val.pair.cdr;
-                s_dec_ref(arg);
-                p = p->val.pair.cdr;
-            }
-            
-            S_Object *result;
-            if (proc_obj->type == S_PROC) {
-                result = proc_obj->val.prim_proc(evaled_args);
-            } else { // S_CLOSURE
-                S_Env *new_env = s_env_new(proc_obj->val.closure.env);
-                
-                S_Object *p_params = proc_obj->val.closure.params;
-                S_Object *p_args = evaled_args;
-                
-                while (p_params->type != S_NIL) {
-                    S_Object *param_sym = p_params->val.pair.car;
-                    S_Object *arg_val = p_args->val.pair.car;
-                    s_env_bind(new_env, param_sym->val.sym_val, arg_val);
-                    p_params = p_params->val.pair.cdr;
-                    p_args = p_args->val.pair.cdr;
+            // S_CLOSURE：实参拷入连续帧槽（槽序即词法寻址的 index），
+            // 之后弹出本帧原地求值函数体——尾调用不增长续延栈
+            S_Object *params = proc_obj->val.closure.params;
+            int np = 0;
+            for (S_Object *q = params; s_type(q) != S_NIL; q = s_cdr(q)) np++;
+
+            S_Env *new_env;
+            if (np <= S_ENV_SMALL_CAP) {
+                new_env = s_env_frame(proc_obj->val.closure.env, np);
+                int i = 0;
+                for (S_Object *q = params; s_type(q) != S_NIL && i < n;
+                     q = s_cdr(q), i++) {
+                    new_env->syms[i] = s_car(q);
+                    new_env->vals[i] = argv[i];
+                }
+                new_env->count = i;
+                // 实参不足时清空余下槽位，同 scheme_apply
+                for (; i < np; i++) new_env->syms[i] = NULL;
+            } else { // 大参数帧：提升为哈希布局，走通用绑定
+                new_env = s_env_new(proc_obj->val.closure.env);
+                int i = 0;
+                for (S_Object *q = params; s_type(q) != S_NIL && i < n;
+                     q = s_cdr(q), i++) {
+                    s_env_bind(new_env, s_car(q), argv[i]);
                 }
-                result = scheme_eval(proc_obj->val.closure.body, new_env);
             }
-            s_dec_ref(evaled_args);
-            return result;
+            arg_top = base;
+            k_top--;
+            expr = proc_obj->val.closure.body;
+            env = new_env;
+            goto eval_loop;
+        }
         }
-        default:
-            fprintf(stderr, "Error: invalid expression\n");
-            exit(1);
     }
-}
\ No newline at end of file
+    return val; // 不可达
+}
@@ -0,0 +1,236 @@
+#include "scheme.h"
+
+// 预编译 AST 镜像（-c 生成，process_file 按魔数自动识别）。
+// 反复加载的大库文件不必每次重新词法分析：镜像把解析产物摊平成
+//   魔数 "SSC1"
+//   u32 符号数；每个符号 u32 长度 + 名字字节
+//   u32 数字数；每个数字 8 字节 IEEE 位模式
+//   u32 节点数；每个节点 (car, cdr) 两个 u32 引用
+//   u32 根数；每个 toplevel 形式一个 u32 引用
+// 引用的低 3 位是标签、高位是下标。子节点总在父节点之前写出，
+// 载入端一遍顺序扫描即可重建，每个 cons 只是一次 slab 指针递增。
+
+#define IMAGE_MAGIC "SSC1"
+
+enum { IM_NODE, IM_SYM, IM_NUM, IM_NIL, IM_TRUE, IM_FALSE };
+#define IM_REF(tag, idx) (((uint32_t)(idx) << 3) | (uint32_t)(tag))
+
+// ---- 写出 ----
+
+typedef struct {
+    S_Object **syms;
+    int sym_len, sym_cap;
+    double *nums;
+    int num_len, num_cap;
+    uint32_t *nodes; // 两个 u32 一组：car, cdr
+    int node_len, node_cap;
+    uint32_t *roots;
+    int root_len, root_cap;
+} Image;
+
+#define IM_PUSH(arr, len, cap, v) do { \
+        if ((len) == (cap)) { \
+            (cap) = (cap) ? (cap) * 2 : 32; \
+            (arr) = realloc((arr), (cap) * sizeof(*(arr))); \
+        } \
+        (arr)[(len)++] = (v); \
+    } while (0)
+
+static uint32_t im_sym(Image *im, S_Object *sym) {
+    for (int i = 0; i < im->sym_len; i++) { // 驻留符号按指针判重
+        if (im->syms[i] == sym) return IM_REF(IM_SYM, i);
+    }
+    IM_PUSH(im->syms, im->sym_len, im->sym_cap, sym);
+    return IM_REF(IM_SYM, im->sym_len - 1);
+}
+
+static uint32_t im_ref(Image *im, S_Object *v) {
+    switch (s_type(v)) {
+        case S_NUMBER:
+            IM_PUSH(im->nums, im->num_len, im->num_cap, s_num_val(v));
+            return IM_REF(IM_NUM, im->num_len - 1);
+        case S_SYMBOL:
+            return im_sym(im, v);
+        case S_NIL:
+            return IM_REF(IM_NIL, 0);
+        case S_BOOL:
+            return IM_REF(s_bool_val(v) ? IM_TRUE : IM_FALSE, 0);
+        case S_PAIR: {
+            uint32_t car = im_ref(im, s_car(v));
+            uint32_t cdr = im_ref(im, s_cdr(v));
+            IM_PUSH(im->nodes, im->node_len, im->node_cap, car);
+            IM_PUSH(im->nodes, im->node_len, im->node_cap, cdr);
+            return IM_REF(IM_NODE, im->node_len / 2 - 1);
+        }
+        default:
+            fprintf(stderr, "Error: cannot serialize object\n");
+            exit(1);
+    }
+}
+
+static void w32(FILE *fp, uint32_t v) {
+    fwrite(&v, sizeof(v), 1, fp);
+}
+
+void scheme_image_write(const char *in_path, const char *out_path) {
+    FILE *in = fopen(in_path, "r");
+    if (!in) {
+        perror("fopen");
+        exit(1);
+    }
+    Image im = { 0 };
+    S_Object *expr;
+    while ((expr = scheme_read(in)) != NULL) {
+        IM_PUSH(im.roots, im.root_len, im.root_cap, im_ref(&im, expr));
+    }
+    scheme_read_end(in);
+    fclose(in);
+
+    FILE *out = fopen(out_path, "wb");
+    if (!out) {
+        perror("fopen");
+        exit(1);
+    }
+    fwrite(IMAGE_MAGIC, 1, 4, out);
+    w32(out, (uint32_t)im.sym_len);
+    for (int i = 0; i < im.sym_len; i++) {
+        const char *name = s_sym_name(im.syms[i]);
+        uint32_t len = (uint32_t)strlen(name);
+        w32(out, len);
+        fwrite(name, 1, len, out);
+    }
+    w32(out, (uint32_t)im.num_len);
+    fwrite(im.nums, sizeof(double), im.num_len, out);
+    w32(out, (uint32_t)(im.node_len / 2));
+    fwrite(im.nodes, sizeof(uint32_t), im.node_len, out);
+    w32(out, (uint32_t)im.root_len);
+    fwrite(im.roots, sizeof(uint32_t), im.root_len, out);
+    fclose(out);
+
+    free(im.syms);
+    free(im.nums);
+    free(im.nodes);
+    free(im.roots);
+}
+
+// ---- 载入 ----
+
+// 识别镜像魔数；不是镜像则回绕到文件头，调用方照常走文本解析
+int scheme_image_check(FILE *fp) {
+    char magic[4];
+    if (fread(magic, 1, 4, fp) == 4 && memcmp(magic, IMAGE_MAGIC, 4) == 0) {
+        return 1;
+    }
+    fseek(fp, 0, SEEK_SET);
+    return 0;
+}
+
+typedef struct {
+    const unsigned char *p, *end;
+} Cursor;
+
+static uint32_t rd32(Cursor *c) {
+    uint32_t v;
+    if (c->p + sizeof(v) > c->end) {
+        fprintf(stderr, "Error: truncated image\n");
+        exit(1);
+    }
+    memcpy(&v, c->p, sizeof(v)); // 缓冲区内无对齐保证
+    c->p += sizeof(v);
+    return v;
+}
+
+static S_Object *im_resolve(uint32_t ref, S_Object **nodes,
+                            S_Object **syms, uint32_t nsyms,
+                            S_Object **nums, uint32_t nnums) {
+    uint32_t idx = ref >> 3;
+    switch (ref & 0x7) {
+        case IM_NODE:  return nodes[idx];
+        case IM_SYM:
+            if (idx >= nsyms) break;
+            return syms[idx];
+        case IM_NUM:
+            if (idx >= nnums) break;
+            return nums[idx];
+        case IM_NIL:   return S_NIL_V;
+        case IM_TRUE:  return S_TRUE_V;
+        case IM_FALSE: return S_FALSE_V;
+    }
+    fprintf(stderr, "Error: corrupt image\n");
+    exit(1);
+}
+
+// 魔数之后的全部内容一次读入，重建 toplevel 形式链表（保持文件顺序）
+S_Object *scheme_image_load(FILE *fp) {
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp) - 4;
+    fseek(fp, 4, SEEK_SET);
+    unsigned char *buf = malloc(size);
+    if (fread(buf, 1, size, fp) != (size_t)size) {
+        fprintf(stderr, "Error: truncated image\n");
+        exit(1);
+    }
+    Cursor c = { buf, buf + size };
+
+    uint32_t nsyms = rd32(&c);
+    S_Object **syms = malloc(nsyms * sizeof(S_Object*));
+    for (uint32_t i = 0; i < nsyms; i++) {
+        uint32_t len = rd32(&c);
+        if (c.p + len > c.end) {
+            fprintf(stderr, "Error: truncated image\n");
+            exit(1);
+        }
+        char *name = malloc(len + 1);
+        memcpy(name, c.p, len);
+        name[len] = '\0';
+        c.p += len;
+        syms[i] = s_symbol(name);
+        free(name);
+    }
+
+    uint32_t nnums = rd32(&c);
+    S_Object **nums = malloc(nnums * sizeof(S_Object*));
+    for (uint32_t i = 0; i < nnums; i++) {
+        double d;
+        if (c.p + sizeof(d) > c.end) {
+            fprintf(stderr, "Error: truncated image\n");
+            exit(1);
+        }
+        memcpy(&d, c.p, sizeof(d));
+        c.p += sizeof(d);
+        nums[i] = s_number(d);
+    }
+
+    uint32_t nnodes = rd32(&c);
+    S_Object **nodes = malloc(nnodes * sizeof(S_Object*));
+    for (uint32_t i = 0; i < nnodes; i++) { // 子节点恒在前，一遍即可
+        uint32_t car = rd32(&c);
+        uint32_t cdr = rd32(&c);
+        if ((car & 0x7) == IM_NODE && (car >> 3) >= i) goto corrupt;
+        if ((cdr & 0x7) == IM_NODE && (cdr >> 3) >= i) goto corrupt;
+        nodes[i] = s_pair(im_resolve(car, nodes, syms, nsyms, nums, nnums),
+                          im_resolve(cdr, nodes, syms, nsyms, nums, nnums));
+    }
+
+    uint32_t nroots = rd32(&c);
+    S_Object *forms = s_nil();
+    S_Object **tail = &forms;
+    for (uint32_t i = 0; i < nroots; i++) {
+        uint32_t ref = rd32(&c);
+        if ((ref & 0x7) == IM_NODE && (ref >> 3) >= nnodes) goto corrupt;
+        S_Object *pair = s_pair(im_resolve(ref, nodes, syms, nsyms, nums, nnums),
+                                s_nil());
+        *tail = pair;
+        tail = &pair->val.pair.cdr;
+    }
+
+    free(syms);
+    free(nums);
+    free(nodes);
+    free(buf);
+    return forms;
+
+corrupt:
+    fprintf(stderr, "Error: corrupt image\n");
+    exit(1);
+}
@@ -1,10 +1,29 @@
 #include "scheme.h"
+#include <unistd.h>
+#include <sys/wait.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <ctype.h>
 
-// 全局环境
-S_Env *global_env;
+// 命令行驱动：解释器本体在 libscheme.a（global_env 归 context.c），
+// 这里只负责旗标解析和文件/REPL/批处理的编排
 
-// 前向声明
-void init_primitives(S_Env *env);
+// 执行引擎：默认树遍历求值器，--vm 切换到字节码虚拟机
+static int use_vm = 0;
+
+// --quiet：不打印 toplevel 结果（只为副作用/计时运行的批处理作业）
+static int quiet = 0;
+
+// --pipeline：读取线程领先求值线程扫描 toplevel 形式（见下）
+static int pipeline = 0;
+
+static S_Object *eval_toplevel(S_Object *expr) {
+    expr = scheme_simplify(expr);
+    if (use_vm) return scheme_vm_eval(expr, global_env);
+    expr = scheme_resolve(expr); // VM 自带编译，词法寻址只服务树遍历器
+    return scheme_eval(expr, global_env);
+}
 
 void repl() {
     printf("Simple Scheme REPL (press Ctrl+D to exit)\n");
@@ -13,12 +32,13 @@ void repl() {
         S_Object *expr = scheme_read(stdin);
         if (!expr) break;
         
-        S_Object *result = scheme_eval(expr, global_env);
-        scheme_print(result);
-        printf("\n");
-        
-        s_dec_ref(expr);
-        s_dec_ref(result);
+        S_Object *result = eval_toplevel(expr);
+        if (result) { // define 等无值形式不打印
+            scheme_print(result);
+            scheme_write("\n");
+        }
+        scheme_write_flush(); // 交互：结果先于下一个提示符落到 stdout
+        s_gc_maybe_collect(); // 安全点：expr/result 均已死亡
     }
 }
 
@@ -28,75 +48,287 @@ void process_file(const char *filename) {
         perror("fopen");
         exit(1);
     }
-    
+
+    if (scheme_image_check(fp)) { // 预编译镜像：跳过词法分析整体载入
+        S_Object *forms = scheme_image_load(fp);
+        fclose(fp);
+        while (s_type(forms) != S_NIL) {
+            s_gc_roots = forms; // 尚未执行的形式不可被 GC 回收
+            S_Object *result = eval_toplevel(s_car(forms));
+            if (result && !quiet) {
+                scheme_print(result);
+                scheme_write("\n");
+            }
+            forms = s_cdr(forms);
+            s_gc_roots = forms;
+            s_gc_maybe_collect(); // 安全点
+        }
+        s_gc_roots = NULL;
+        scheme_write_flush();
+        return;
+    }
+
     S_Object *expr;
     while ((expr = scheme_read(fp)) != NULL) {
-        S_Object *result = scheme_eval(expr, global_env);
-        scheme_print(result);
-        printf("\n");
-        s_dec_ref(expr);
-        s_dec_ref(result);
+        S_Object *result = eval_toplevel(expr);
+        if (result && !quiet) { // define 等无值形式不打印
+            scheme_print(result);
+            scheme_write("\n");
+        }
+        s_gc_maybe_collect(); // 安全点：expr/result 均已死亡
+    }
+
+    scheme_read_end(fp);
+    fclose(fp);
+    scheme_write_flush();
+}
+
+// ---- 流水线模式（--pipeline）----
+// 读取线程在求值线程前方扫描 toplevel 形式。解释器状态全是线程
+// 局部量，S_Object 不能跨线程，所以跨线程传的只有字节：读取线程
+// 做纯 I/O 加括号配平（本语言无字符串字面量，只需认括号、空白和
+// 行注释），切出完整形式的源文本经有界无锁 SPSC 环递过来，求值
+// 线程再解析求值。扫描和文件 I/O 藏在求值背后，总耗时趋近
+// max(读取, 求值) 而非两者之和。
+
+#define PIPE_QUEUE_CAP 64 // 2 的幂，下标取模用位与
+
+static char *pipe_queue[PIPE_QUEUE_CAP];
+static _Atomic size_t pipe_head, pipe_tail; // 消费/生产游标，单调递增
+
+static void pipe_push(char *form) {
+    size_t tail = atomic_load_explicit(&pipe_tail, memory_order_relaxed);
+    while (tail - atomic_load_explicit(&pipe_head, memory_order_acquire)
+           == PIPE_QUEUE_CAP) {
+        sched_yield(); // 队列满：读取线程领先太多，让路
+    }
+    pipe_queue[tail & (PIPE_QUEUE_CAP - 1)] = form;
+    atomic_store_explicit(&pipe_tail, tail + 1, memory_order_release);
+}
+
+static char *pipe_pop(void) {
+    size_t head = atomic_load_explicit(&pipe_head, memory_order_relaxed);
+    while (atomic_load_explicit(&pipe_tail, memory_order_acquire) == head) {
+        sched_yield(); // 队列空：等读取线程
+    }
+    char *form = pipe_queue[head & (PIPE_QUEUE_CAP - 1)];
+    atomic_store_explicit(&pipe_head, head + 1, memory_order_release);
+    return form;
+}
+
+// 形式文本累积缓冲（仅读取线程触碰）
+static char *pipe_buf = NULL;
+static size_t pipe_buf_len = 0, pipe_buf_cap = 0;
+
+static void pb_add(char c) {
+    if (pipe_buf_len == pipe_buf_cap) {
+        pipe_buf_cap = pipe_buf_cap ? pipe_buf_cap * 2 : 256;
+        pipe_buf = realloc(pipe_buf, pipe_buf_cap);
+    }
+    pipe_buf[pipe_buf_len++] = c;
+}
+
+static void pb_emit(void) {
+    if (!pipe_buf_len) return;
+    pb_add('\0');
+    pipe_push(pipe_buf); // 所有权移交求值线程，由它 free
+    pipe_buf = NULL;
+    pipe_buf_len = pipe_buf_cap = 0;
+}
+
+static void *pipe_reader(void *arg) {
+    FILE *fp = fopen(arg, "r");
+    if (!fp) {
+        perror("fopen");
+        exit(1);
     }
-    
+    int depth = 0, comment = 0;
+    int c;
+    while ((c = fgetc(fp)) != EOF) {
+        if (comment) {
+            if (c == '\n') comment = 0;
+            continue; // 注释不进形式文本
+        }
+        if (c == ';') {
+            comment = 1;
+            if (depth == 0) pb_emit(); // 注释也终结 toplevel 原子
+            continue;
+        }
+        if (depth == 0 && isspace(c)) {
+            pb_emit(); // 空白终结 toplevel 原子
+            continue;
+        }
+        pb_add((char)c);
+        if (c == '(') {
+            depth++;
+        } else if (c == ')') {
+            if (--depth == 0) pb_emit(); // 括号配平：一个完整形式
+        }
+    }
+    pb_emit(); // 文件尾的原子
     fclose(fp);
+    pipe_push(NULL); // 哨兵：文件读完
+    return NULL;
+}
+
+static void process_file_pipeline(const char *filename) {
+    FILE *probe = fopen(filename, "r");
+    if (!probe) {
+        perror("fopen");
+        exit(1);
+    }
+    if (scheme_image_check(probe)) { // 镜像本就免解析，无需流水线
+        fclose(probe);
+        process_file(filename);
+        return;
+    }
+    fclose(probe);
+
+    atomic_store(&pipe_head, 0);
+    atomic_store(&pipe_tail, 0);
+    pthread_t tid;
+    pthread_create(&tid, NULL, pipe_reader, (void*)filename);
+
+    char *form;
+    while ((form = pipe_pop()) != NULL) {
+        S_Object *expr = scheme_parse(form);
+        free(form);
+        if (!expr) continue;
+        S_Object *result = eval_toplevel(expr);
+        if (result && !quiet) {
+            scheme_print(result);
+            scheme_write("\n");
+        }
+        s_gc_maybe_collect(); // 安全点：expr/result 均已死亡
+    }
+    pthread_join(tid, NULL);
+    scheme_write_flush();
+}
+
+// 按旗标选择文件执行方式（批处理的工作进程也经由此处）
+static void run_file(const char *filename) {
+    if (pipeline) {
+        process_file_pipeline(filename);
+    } else {
+        process_file(filename);
+    }
 }
 
-void scheme_print(S_Object *obj) {
-    if (!obj) return;
-    
-    switch (obj->type) {
-        case S_NUMBER:
-            printf("%g", obj->val.num_val);
-            break;
-        case S_BOOL:
-            printf("#%c", obj->val.bool_val ? 't' : 'f');
-            break;
-        case S_SYMBOL:
-            printf("%s", obj->val.sym_val);
-            break;
-        case S_PAIR:
-            printf("(");
-            scheme_print(obj->val.pair.car);
-            S_Object *cdr = obj->val.pair.cdr;
-            while (cdr->type == S_PAIR) {
-                printf(" ");
-                scheme_print(cdr->val.pair.car);
-                cdr = cdr->val.pair.cdr;
+// 批处理模式（--jobs N file1 file2 ...）：每个文件在独立的工作进程中
+// 求值。全局环境和原语在 fork 之前初始化完毕，子进程以写时复制共享
+// 这份只读快照，各自的堆互不干扰，也省掉了每个文件的进程启动开销里
+// 可控的那部分（初始化只做一次）。并发窗口最多 jobs 个子进程；输出经
+// 管道回收，严格按文件顺序打印，与逐个串行运行不可区分。
+static void process_batch(char **files, int nfiles, int jobs) {
+    pid_t *pids = malloc(nfiles * sizeof(pid_t));
+    int *fds = malloc(nfiles * sizeof(int));
+    int started = 0;
+
+    for (int i = 0; i < nfiles; i++) {
+        // 保持窗口：最多领先当前回收位置 jobs 个
+        while (started < nfiles && started < i + jobs) {
+            int pipefd[2];
+            if (pipe(pipefd) < 0) {
+                perror("pipe");
+                exit(1);
             }
-            if (cdr->type != S_NIL) {
-                printf(" . ");
-                scheme_print(cdr);
+            fflush(stdout); // 勿让子进程继承未冲刷的输出缓冲
+            pid_t pid = fork();
+            if (pid < 0) {
+                perror("fork");
+                exit(1);
             }
-            printf(")");
-            break;
-        case S_NIL:
-            printf("()");
-            break;
-        case S_PROC:
-            printf("#<procedure>");
-            break;
-        case S_CLOSURE:
-            printf("#<closure>");
-            break;
+            if (pid == 0) { // 工作进程：stdout 重定向到管道后正常求值
+                close(pipefd[0]);
+                dup2(pipefd[1], STDOUT_FILENO);
+                close(pipefd[1]);
+                run_file(files[started]);
+                if (s_profile_on) s_profile_dump();
+                exit(0);
+            }
+            close(pipefd[1]);
+            pids[started] = pid;
+            fds[started] = pipefd[0];
+            started++;
+        }
+
+        char buf[4096];
+        ssize_t n;
+        while ((n = read(fds[i], buf, sizeof(buf))) > 0) {
+            fwrite(buf, 1, n, stdout);
+        }
+        close(fds[i]);
+
+        int status;
+        waitpid(pids[i], &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            exit(1); // 子进程已把错误打到 stderr
+        }
     }
+    free(pids);
+    free(fds);
 }
 
 int main(int argc, char **argv) {
-    global_env = s_env_new(NULL);
-    init_primitives(global_env);
-    
-    if (argc == 1) {
-        repl();
-    } else if (argc == 2) {
-        process_file(argv[1]);
+    scheme_context_new(); // 主线程的解释器实例，进程存活期内不销毁
+
+    char **files = malloc(argc * sizeof(char*));
+    int nfiles = 0;
+    int jobs = 1;
+    int compile = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--vm") == 0) {
+            use_vm = 1;
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            s_profile_on = 1;
+        } else if (strcmp(argv[i], "-c") == 0) {
+            compile = 1;
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            quiet = 1;
+        } else if (strcmp(argv[i], "--pipeline") == 0) {
+            pipeline = 1;
+        } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            jobs = atoi(argv[++i]);
+            if (jobs < 1) jobs = 1;
+        } else if (argv[i][0] != '-') {
+            files[nfiles++] = argv[i];
+        } else {
+            fprintf(stderr,
+                    "Usage: %s [--vm] [--profile] [--quiet] [--pipeline] [--jobs N] [-c] [file.ss ...]\n",
+                    argv[0]);
+            exit(1);
+        }
+    }
+
+    if (compile) { // -c：file.ss -> file.ssc，只解析不求值
+        for (int i = 0; i < nfiles; i++) {
+            size_t len = strlen(files[i]);
+            char *out = malloc(len + 2);
+            strcpy(out, files[i]);
+            if (len > 3 && strcmp(out + len - 3, ".ss") == 0) {
+                strcat(out, "c");
+            } else {
+                out = realloc(out, len + 5);
+                strcat(out, ".ssc");
+            }
+            scheme_image_write(files[i], out);
+            fprintf(stderr, "wrote %s\n", out);
+            free(out);
+        }
+        free(files);
+        return 0;
+    }
+
+    if (nfiles > 1 || (nfiles == 1 && jobs > 1)) {
+        // 多文件彼此独立：即使 --jobs 1 也走批处理，每个文件一份干净环境
+        process_batch(files, nfiles, jobs);
+    } else if (nfiles == 1) {
+        run_file(files[0]);
     } else {
-        fprintf(stderr, "Usage: %s [file.ss]\n", argv[0]);
-        exit(1);
+        repl();
     }
-    
-    // 简单的清理
-    // s_dec_ref(global_env->bindings);
-    free(global_env);
-    
+    free(files);
+
+    if (s_profile_on) s_profile_dump();
     return 0;
 }
\ No newline at end of file
@@ -1,67 +1,140 @@
 #include "scheme.h"
 #include <ctype.h>
 
+// 带缓冲的块读取词法器：一次 fread 读入大块数据，用指针扫描切出
+// token，取代逐字符 getc/ungetc 加 fscanf 的旧路径。
+// 交互式输入（stdin）按行填充缓冲区，保持 REPL 的即时响应。
+#define READER_BUF_SIZE 65536
+
+typedef struct {
+    FILE *stream;
+    char buf[READER_BUF_SIZE];
+    size_t len, pos;
+    int interactive;
+} S_Reader;
+
+static int r_fill(S_Reader *r) {
+    r->pos = 0;
+    if (r->interactive) {
+        r->len = fgets(r->buf, READER_BUF_SIZE, r->stream) ? strlen(r->buf) : 0;
+    } else {
+        r->len = fread(r->buf, 1, READER_BUF_SIZE, r->stream);
+    }
+    return r->len > 0;
+}
+
+static int r_peek(S_Reader *r) {
+    if (r->pos == r->len && !r_fill(r)) return EOF;
+    return (unsigned char)r->buf[r->pos];
+}
+
+static void r_skip_space(S_Reader *r) {
+    for (;;) {
+        int c = r_peek(r);
+        if (c == ';') { // 行注释，跳到行尾
+            do {
+                r->pos++;
+                c = r_peek(r);
+            } while (c != EOF && c != '\n');
+        } else if (c != EOF && isspace(c)) {
+            r->pos++;
+        } else {
+            return;
+        }
+    }
+}
+
 static int is_delimiter(int c) {
-    return isspace(c) || c == '(' || c == ')' || c == EOF;
+    return c == EOF || isspace(c) || c == '(' || c == ')' || c == ';';
 }
 
-static S_Object *read_token(FILE *stream) {
-    int c;
-    while ((c = getc(stream)) != EOF) {
-        if (!isspace(c)) {
-            ungetc(c, stream);
-            break;
+static S_Object *read_expr(S_Reader *r);
+
+static S_Object *read_list(S_Reader *r) {
+    S_Object *list = s_nil();
+    S_Object **tail = &list;
+    for (;;) {
+        r_skip_space(r);
+        int c = r_peek(r);
+        if (c == EOF) {
+            fprintf(stderr, "Error: expected ')'\n");
+            exit(1);
+        }
+        if (c == ')') {
+            r->pos++;
+            return list;
         }
+        S_Object *expr = read_expr(r);
+        S_Object *pair = s_pair(expr, s_nil());
+        *tail = pair;
+        tail = &pair->val.pair.cdr;
     }
+}
+
+static S_Object *read_expr(S_Reader *r) {
+    r_skip_space(r);
+    int c = r_peek(r);
     if (c == EOF) return NULL;
-    
-    c = getc(stream);
+
     if (c == '(') {
-        // 列表
-        S_Object *list = s_nil();
-        S_Object **tail = &list;
-        while ((c = getc(stream)) != EOF && c != ')') {
-            ungetc(c, stream);
-            S_Object *expr = scheme_read(stream);
-            if (!expr) {
-                fprintf(stderr, "Error: expected ')'\n");
-                exit(1);
-            }
-            S_Object *pair = s_pair(expr, s_nil());
-            *tail = pair;
-            tail = &pair->val.pair.cdr;
-        }
-        return list;
-    } else if (c == ')') {
+        r->pos++;
+        return read_list(r);
+    }
+    if (c == ')') {
         fprintf(stderr, "Error: unexpected ')'\n");
         exit(1);
-    } else if (isdigit(c) || (c == '-' && isdigit(getc(stream)))) {
-        ungetc(c, stream);
-        double num;
-        fscanf(stream, "%lf", &num);
-        return s_number(num);
-    } else if (c == '#') {
-        c = getc(stream);
-        if (c == 't') return s_bool(1);
-        if (c == 'f') return s_bool(0);
+    }
+
+    // 原子：按分隔符切出完整 token（可能跨缓冲区边界，拷出暂存）
+    char tok[256];
+    size_t n = 0;
+    while (!is_delimiter(c = r_peek(r))) {
+        if (n < sizeof(tok) - 1) tok[n++] = (char)c;
+        r->pos++;
+    }
+    tok[n] = '\0';
+
+    if (tok[0] == '#') {
+        if (strcmp(tok, "#t") == 0) return S_TRUE_V;
+        if (strcmp(tok, "#f") == 0) return S_FALSE_V;
         fprintf(stderr, "Error: invalid boolean literal\n");
         exit(1);
-    } else {
-        // 符号
-        char buf[256];
-        int i = 0;
-        buf[i++] = c;
-        while (!is_delimiter(c = getc(stream))) {
-            buf[i++] = c;
-            if (i >= sizeof(buf) - 1) break;
-        }
-        buf[i] = '\0';
-        ungetc(c, stream);
-        return s_symbol(buf);
     }
+    if (isdigit((unsigned char)tok[0]) ||
+        (tok[0] == '-' && isdigit((unsigned char)tok[1]))) {
+        return s_number(strtod(tok, NULL));
+    }
+    return s_symbol(tok);
 }
 
-// 主读取函数
+static _Thread_local S_Reader reader;
+
+// 主读取函数：保持 FILE* 接口，内部绑定到带缓冲的读取器
 S_Object *scheme_read(FILE *stream) {
-    return read_token(stream);
-}
\ No newline at end of file
+    if (reader.stream != stream) {
+        reader.stream = stream;
+        reader.len = 0;
+        reader.pos = 0;
+        reader.interactive = (stream == stdin);
+    }
+    return read_expr(&reader);
+}
+
+// 读完一个文件后由调用方解除绑定：fclose 之后 FILE* 地址可能被
+// 下一个 fopen 复用，不解除会让新文件误用旧缓冲
+void scheme_read_end(FILE *stream) {
+    if (reader.stream == stream) reader.stream = NULL;
+}
+
+// 解析字符串中的第一个表达式（嵌入 API 用）
+S_Object *scheme_parse(const char *str) {
+    FILE *fp = fmemopen((void*)str, strlen(str), "r");
+    if (!fp) {
+        perror("fmemopen");
+        exit(1);
+    }
+    S_Object *expr = scheme_read(fp);
+    scheme_read_end(fp);
+    fclose(fp);
+    return expr;
+}
@@ -1,147 +1,464 @@
 #include "scheme.h"
 
-static void check_arg_count(S_Object *args, int min, int max) {
-    int count = 0;
-    S_Object *p = args;
-    while (p->type != S_NIL) {
-        count++;
-        p = p->val.pair.cdr;
-    }
-    if (count < min || (max != -1 && count > max)) {
-        fprintf(stderr, "Error: incorrect number of arguments\n");
-        exit(1);
-    }
-}
+// 原语按数组约定接收实参：求值器把求好的值连续排在参数栈上，
+// 这里只看 (argv, argc)。元数由文件末尾的描述符表统一声明，
+// 分发方在调用前按表检查一次（s_prim_check_arity），各实现
+// 不再自行校验；二元热点另备 (a, b) 直调变体，免去数组中转。
 
-S_Object *prim_add(S_Object *args) {
+S_Object *prim_add(S_Object **argv, int argc) {
+    if (argc == 2 && s_is_fixnum(argv[0]) && s_is_fixnum(argv[1])) {
+        // 两个 46 位载荷的和不会溢出 int64，s_int 只做范围检查
+        return s_int(s_fix_val(argv[0]) + s_fix_val(argv[1]));
+    }
     double sum = 0.0;
-    S_Object *p = args;
-    while (p->type != S_NIL) {
-        S_Object *arg = p->val.pair.car;
-        if (arg->type != S_NUMBER) {
+    for (int i = 0; i < argc; i++) {
+        if (!s_is_number(argv[i])) {
             fprintf(stderr, "Error: '+' requires numbers\n");
             exit(1);
         }
-        sum += arg->val.num_val;
-        p = p->val.pair.cdr;
+        sum += s_num_val(argv[i]);
     }
     return s_number(sum);
 }
 
-S_Object *prim_sub(S_Object *args) {
-    check_arg_count(args, 1, 2);
-    S_Object *first = args->val.pair.car;
-    if (first->type != S_NUMBER) {
+S_Object *prim_sub(S_Object **argv, int argc) {
+    if (argc == 2 && s_is_fixnum(argv[0]) && s_is_fixnum(argv[1])) {
+        return s_int(s_fix_val(argv[0]) - s_fix_val(argv[1]));
+    }
+    if (!s_is_number(argv[0])) {
         fprintf(stderr, "Error: '-' requires numbers\n");
         exit(1);
     }
-    if (args->val.pair.cdr->type == S_NIL) { // Unary minus
-        return s_number(-first->val.num_val);
+    if (argc == 1) { // Unary minus
+        return s_number(-s_num_val(argv[0]));
     }
-    S_Object *second = args->val.pair.cdr->val.pair.car;
-    if (second->type != S_NUMBER) {
+    if (!s_is_number(argv[1])) {
         fprintf(stderr, "Error: '-' requires numbers\n");
         exit(1);
     }
-    return s_number(first->val.num_val - second->val.num_val);
+    return s_number(s_num_val(argv[0]) - s_num_val(argv[1]));
 }
 
-S_Object *prim_mul(S_Object *args) {
+S_Object *prim_mul(S_Object **argv, int argc) {
+    if (argc == 2 && s_is_fixnum(argv[0]) && s_is_fixnum(argv[1])) {
+        int64_t r;
+        if (!__builtin_mul_overflow(s_fix_val(argv[0]),
+                                    s_fix_val(argv[1]), &r)) {
+            return s_int(r);
+        } // int64 都装不下：掉到 double 路径
+    }
     double product = 1.0;
-    S_Object *p = args;
-    while (p->type != S_NIL) {
-        S_Object *arg = p->val.pair.car;
-        if (arg->type != S_NUMBER) {
+    for (int i = 0; i < argc; i++) {
+        if (!s_is_number(argv[i])) {
             fprintf(stderr, "Error: '*' requires numbers\n");
             exit(1);
         }
-        product *= arg->val.num_val;
-        p = p->val.pair.cdr;
+        product *= s_num_val(argv[i]);
     }
     return s_number(product);
 }
 
-S_Object *prim_div(S_Object *args) {
-    check_arg_count(args, 1, 2);
-    S_Object *first = args->val.pair.car;
-    if (first->type != S_NUMBER) {
+S_Object *prim_div(S_Object **argv, int argc) {
+    if (!s_is_number(argv[0])) {
         fprintf(stderr, "Error: '/' requires numbers\n");
         exit(1);
     }
-    if (args->val.pair.cdr->type == S_NIL) { // Unary division (reciprocal)
-        if (first->val.num_val == 0.0) {
+    if (argc == 1) { // Unary division (reciprocal)
+        if (s_num_val(argv[0]) == 0.0) {
             fprintf(stderr, "Error: division by zero\n");
             exit(1);
         }
-        return s_number(1.0 / first->val.num_val);
+        return s_number(1.0 / s_num_val(argv[0]));
     }
-    S_Object *second = args->val.pair.cdr->val.pair.car;
-    if (second->type != S_NUMBER) {
+    if (!s_is_number(argv[1])) {
         fprintf(stderr, "Error: '/' requires numbers\n");
         exit(1);
     }
-    if (second->val.num_val == 0.0) {
+    if (s_num_val(argv[1]) == 0.0) {
         fprintf(stderr, "Error: division by zero\n");
         exit(1);
     }
-    return s_number(first->val.num_val / second->val.num_val);
+    return s_number(s_num_val(argv[0]) / s_num_val(argv[1]));
 }
 
-S_Object *prim_eq(S_Object *args) {
-    check_arg_count(args, 2, 2);
-    S_Object *first = args->val.pair.car;
-    S_Object *second = args->val.pair.cdr->val.pair.car;
-    if (first->type != second->type) {
-        return s_bool(0);
+S_Object *prim_eq(S_Object **argv, int argc) {
+    (void)argc; // 元数已由描述符统一检查
+    if (s_is_fixnum(argv[0]) && s_is_fixnum(argv[1])) {
+        return s_bool(argv[0] == argv[1]); // 定点编码规范化，同值同码
     }
-    if (first->type == S_NUMBER) {
-        return s_bool(first->val.num_val == second->val.num_val);
-    } else if (first->type == S_BOOL) {
-        return s_bool(first->val.bool_val == second->val.bool_val);
-    } else {
-        return s_bool(0);
+    if (s_is_number(argv[0]) && s_is_number(argv[1])) {
+        return s_bool(s_num_val(argv[0]) == s_num_val(argv[1]));
     }
+    // 布尔/nil 是规范化立即数，指针相等即值相等
+    return s_bool(argv[0] == argv[1] && !s_is_heap(argv[0]));
 }
 
-S_Object *prim_lt(S_Object *args) {
-    check_arg_count(args, 2, 2);
-    S_Object *first = args->val.pair.car;
-    S_Object *second = args->val.pair.cdr->val.pair.car;
-    if (first->type != S_NUMBER || second->type != S_NUMBER) {
+S_Object *prim_lt(S_Object **argv, int argc) {
+    (void)argc; // 元数已由描述符统一检查
+    if (s_is_fixnum(argv[0]) && s_is_fixnum(argv[1])) {
+        return s_bool(s_fix_val(argv[0]) < s_fix_val(argv[1]));
+    }
+    if (!s_is_number(argv[0]) || !s_is_number(argv[1])) {
         fprintf(stderr, "Error: '<' requires numbers\n");
         exit(1);
     }
-    return s_bool(first->val.num_val < second->val.num_val);
+    return s_bool(s_num_val(argv[0]) < s_num_val(argv[1]));
 }
 
-S_Object *prim_gt(S_Object *args) {
-    check_arg_count(args, 2, 2);
-    S_Object *first = args->val.pair.car;
-    S_Object *second = args->val.pair.cdr->val.pair.car;
-    if (first->type != S_NUMBER || second->type != S_NUMBER) {
+S_Object *prim_gt(S_Object **argv, int argc) {
+    (void)argc; // 元数已由描述符统一检查
+    if (s_is_fixnum(argv[0]) && s_is_fixnum(argv[1])) {
+        return s_bool(s_fix_val(argv[0]) > s_fix_val(argv[1]));
+    }
+    if (!s_is_number(argv[0]) || !s_is_number(argv[1])) {
         fprintf(stderr, "Error: '>' requires numbers\n");
         exit(1);
     }
-    return s_bool(first->val.num_val > second->val.num_val);
+    return s_bool(s_num_val(argv[0]) > s_num_val(argv[1]));
+}
+
+S_Object *prim_le(S_Object **argv, int argc) {
+    (void)argc; // 元数已由描述符统一检查
+    if (s_is_fixnum(argv[0]) && s_is_fixnum(argv[1])) {
+        return s_bool(s_fix_val(argv[0]) <= s_fix_val(argv[1]));
+    }
+    if (!s_is_number(argv[0]) || !s_is_number(argv[1])) {
+        fprintf(stderr, "Error: '<=' requires numbers\n");
+        exit(1);
+    }
+    return s_bool(s_num_val(argv[0]) <= s_num_val(argv[1]));
+}
+
+S_Object *prim_ge(S_Object **argv, int argc) {
+    (void)argc; // 元数已由描述符统一检查
+    if (s_is_fixnum(argv[0]) && s_is_fixnum(argv[1])) {
+        return s_bool(s_fix_val(argv[0]) >= s_fix_val(argv[1]));
+    }
+    if (!s_is_number(argv[0]) || !s_is_number(argv[1])) {
+        fprintf(stderr, "Error: '>=' requires numbers\n");
+        exit(1);
+    }
+    return s_bool(s_num_val(argv[0]) >= s_num_val(argv[1]));
+}
+
+// ---- 二实参直调变体 ----
+// 求值器对恰有两个实参的调用走这里：实参留在寄存器里，不经过
+// 参数栈。非定点情形拼一个局部数组退回通用实现，错误路径只写一份。
+
+S_Object *prim_add2(S_Object *a, S_Object *b) {
+    if (s_is_fixnum(a) && s_is_fixnum(b)) {
+        return s_int(s_fix_val(a) + s_fix_val(b));
+    }
+    S_Object *argv[2] = { a, b };
+    return prim_add(argv, 2);
+}
+
+S_Object *prim_sub2(S_Object *a, S_Object *b) {
+    if (s_is_fixnum(a) && s_is_fixnum(b)) {
+        return s_int(s_fix_val(a) - s_fix_val(b));
+    }
+    S_Object *argv[2] = { a, b };
+    return prim_sub(argv, 2);
+}
+
+S_Object *prim_mul2(S_Object *a, S_Object *b) {
+    if (s_is_fixnum(a) && s_is_fixnum(b)) {
+        int64_t r;
+        if (!__builtin_mul_overflow(s_fix_val(a), s_fix_val(b), &r)) {
+            return s_int(r);
+        }
+    }
+    S_Object *argv[2] = { a, b };
+    return prim_mul(argv, 2);
+}
+
+S_Object *prim_div2(S_Object *a, S_Object *b) {
+    S_Object *argv[2] = { a, b };
+    return prim_div(argv, 2);
+}
+
+S_Object *prim_eq2(S_Object *a, S_Object *b) {
+    if (s_is_fixnum(a) && s_is_fixnum(b)) {
+        return s_bool(a == b); // 定点编码规范化，同值同码
+    }
+    S_Object *argv[2] = { a, b };
+    return prim_eq(argv, 2);
 }
 
-S_Object *prim_not(S_Object *args) {
-    check_arg_count(args, 1, 1);
-    S_Object *arg = args->val.pair.car;
-    if (arg->type != S_BOOL) {
+S_Object *prim_lt2(S_Object *a, S_Object *b) {
+    if (s_is_fixnum(a) && s_is_fixnum(b)) {
+        return s_bool(s_fix_val(a) < s_fix_val(b));
+    }
+    S_Object *argv[2] = { a, b };
+    return prim_lt(argv, 2);
+}
+
+S_Object *prim_gt2(S_Object *a, S_Object *b) {
+    if (s_is_fixnum(a) && s_is_fixnum(b)) {
+        return s_bool(s_fix_val(a) > s_fix_val(b));
+    }
+    S_Object *argv[2] = { a, b };
+    return prim_gt(argv, 2);
+}
+
+S_Object *prim_le2(S_Object *a, S_Object *b) {
+    if (s_is_fixnum(a) && s_is_fixnum(b)) {
+        return s_bool(s_fix_val(a) <= s_fix_val(b));
+    }
+    S_Object *argv[2] = { a, b };
+    return prim_le(argv, 2);
+}
+
+S_Object *prim_ge2(S_Object *a, S_Object *b) {
+    if (s_is_fixnum(a) && s_is_fixnum(b)) {
+        return s_bool(s_fix_val(a) >= s_fix_val(b));
+    }
+    S_Object *argv[2] = { a, b };
+    return prim_ge(argv, 2);
+}
+
+S_Object *prim_not(S_Object **argv, int argc) {
+    (void)argc; // 元数已由描述符统一检查
+    if (s_type(argv[0]) != S_BOOL) {
         fprintf(stderr, "Error: 'not' requires a boolean\n");
         exit(1);
     }
-    return s_bool(!arg->val.bool_val);
+    return s_bool(!s_bool_val(argv[0]));
+}
+
+// ---- 向量：连续 double 数组上的流式核心 ----
+// 数据紧凑排布，下面的循环都是可向量化的顺序扫描，没有逐元素指针追逐
+
+static S_Object *check_vector(S_Object *v, const char *who) {
+    if (s_type(v) != S_VECTOR) {
+        fprintf(stderr, "Error: '%s' requires a vector\n", who);
+        exit(1);
+    }
+    return v;
+}
+
+S_Object *prim_make_vector(S_Object **argv, int argc) {
+    if (!s_is_number(argv[0]) || s_num_val(argv[0]) < 0) {
+        fprintf(stderr, "Error: 'make-vector' requires a non-negative size\n");
+        exit(1);
+    }
+    int len = (int)s_num_val(argv[0]);
+    S_Object *v = s_vector(len);
+    if (argc == 2) {
+        if (!s_is_number(argv[1])) {
+            fprintf(stderr, "Error: 'make-vector' fill must be a number\n");
+            exit(1);
+        }
+        double fill = s_num_val(argv[1]);
+        double *data = s_vec_data(v);
+        for (int i = 0; i < len; i++) data[i] = fill;
+    }
+    return v;
+}
+
+S_Object *prim_vector_length(S_Object **argv, int argc) {
+    (void)argc; // 元数已由描述符统一检查
+    return s_int(s_vec_len(check_vector(argv[0], "vector-length")));
+}
+
+S_Object *prim_vector_ref(S_Object **argv, int argc) {
+    (void)argc; // 元数已由描述符统一检查
+    S_Object *v = check_vector(argv[0], "vector-ref");
+    if (!s_is_number(argv[1])) {
+        fprintf(stderr, "Error: 'vector-ref' index must be a number\n");
+        exit(1);
+    }
+    int i = (int)s_num_val(argv[1]);
+    if (i < 0 || i >= s_vec_len(v)) {
+        fprintf(stderr, "Error: 'vector-ref' index out of range\n");
+        exit(1);
+    }
+    return s_number(s_vec_data(v)[i]);
+}
+
+S_Object *prim_vector_map(S_Object **argv, int argc) {
+    (void)argc; // 元数已由描述符统一检查
+    // argv 指向求值器的参数栈，回调重入求值器可能 realloc 该栈，
+    // 因此先把要跨回调使用的实参拷到局部（同 s_memo_call 的键快照）
+    S_Object *proc = argv[0];
+    S_Object *v = check_vector(argv[1], "vector-map");
+    int len = s_vec_len(v);
+    S_Object *out = s_vector(len);
+    double *in_data = s_vec_data(v);
+    double *out_data = s_vec_data(out);
+    for (int i = 0; i < len; i++) {
+        S_Object *x = s_number(in_data[i]);
+        S_Object *r = scheme_apply(proc, &x, 1);
+        if (!s_is_number(r)) {
+            fprintf(stderr, "Error: 'vector-map' procedure must return a number\n");
+            exit(1);
+        }
+        out_data[i] = s_num_val(r);
+    }
+    return out;
+}
+
+S_Object *prim_vector_sum(S_Object **argv, int argc) {
+    (void)argc; // 元数已由描述符统一检查
+    S_Object *v = check_vector(argv[0], "vector-sum");
+    double *data = s_vec_data(v);
+    int len = s_vec_len(v);
+    double sum = 0.0;
+    for (int i = 0; i < len; i++) sum += data[i];
+    return s_number(sum);
+}
+
+// 逐元素运算的公共骨架：长度必须一致
+static S_Object *vector_zip(S_Object **argv, const char *who, int mul) {
+    S_Object *a = check_vector(argv[0], who);
+    S_Object *b = check_vector(argv[1], who);
+    if (s_vec_len(a) != s_vec_len(b)) {
+        fprintf(stderr, "Error: '%s' requires equal-length vectors\n", who);
+        exit(1);
+    }
+    int len = s_vec_len(a);
+    S_Object *out = s_vector(len);
+    double *pa = s_vec_data(a), *pb = s_vec_data(b), *po = s_vec_data(out);
+    if (mul) {
+        for (int i = 0; i < len; i++) po[i] = pa[i] * pb[i];
+    } else {
+        for (int i = 0; i < len; i++) po[i] = pa[i] + pb[i];
+    }
+    return out;
+}
+
+S_Object *prim_vector_add(S_Object **argv, int argc) {
+    (void)argc; // 元数已由描述符统一检查
+    return vector_zip(argv, "vector-add", 0);
+}
+
+S_Object *prim_vector_mul(S_Object **argv, int argc) {
+    (void)argc; // 元数已由描述符统一检查
+    return vector_zip(argv, "vector-mul", 1);
+}
+
+// ---- memoize：实参键缓存的过程包装 ----
+// 数字/布尔/nil 已规范化为唯一编码字（同值同码），实参编码字序列
+// 就是缓存键，比较只是逐字相等。含堆实参（向量等）的调用按指针
+// 比较没有意义，直接旁路到真实过程。
+
+static uint64_t memo_hash(S_Object **argv, int argc) {
+    uint64_t h = 1469598103934665603ULL; // FNV-1a，按 64 位字混入
+    for (int i = 0; i < argc; i++) {
+        h ^= (uint64_t)argv[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static void memo_grow(S_MemoCache *mc) {
+    size_t old_cap = mc->cap;
+    S_MemoEntry **old = mc->buckets;
+    mc->cap = old_cap * 2;
+    mc->buckets = calloc(mc->cap, sizeof(S_MemoEntry*));
+    for (size_t j = 0; j < old_cap; j++) {
+        S_MemoEntry *e = old[j];
+        while (e) {
+            S_MemoEntry *next = e->next;
+            size_t i = memo_hash(e->args, e->argc) & (mc->cap - 1);
+            e->next = mc->buckets[i];
+            mc->buckets[i] = e;
+            e = next;
+        }
+    }
+    free(old);
+}
+
+S_Object *s_memo_call(S_Object *memo, S_Object **argv, int argc) {
+    for (int i = 0; i < argc; i++) {
+        if (s_is_heap(argv[i])) { // 堆实参不可缓存，旁路
+            return scheme_apply(memo->val.memo.proc, argv, argc);
+        }
+    }
+    S_MemoCache *mc = memo->val.memo.cache;
+    size_t i = memo_hash(argv, argc) & (mc->cap - 1);
+    for (S_MemoEntry *e = mc->buckets[i]; e; e = e->next) {
+        if (e->argc == argc &&
+            memcmp(e->args, argv, argc * sizeof(S_Object*)) == 0) {
+            return e->value;
+        }
+    }
+    // 未命中：先把键拷出来再应用——argv 指向求值器参数栈，
+    // 递归应用（记忆化递归的典型路径）可能让栈扩容搬家
+    S_Object **key = malloc((argc ? argc : 1) * sizeof(S_Object*));
+    memcpy(key, argv, argc * sizeof(S_Object*));
+    S_Object *result = scheme_apply(memo->val.memo.proc, argv, argc);
+    if (mc->count * 4 >= mc->cap * 3) memo_grow(mc); // 负载因子 3/4
+    i = memo_hash(key, argc) & (mc->cap - 1); // 递归可能已扩容，重定位
+    S_MemoEntry *e = malloc(sizeof(S_MemoEntry));
+    e->args = key;
+    e->argc = argc;
+    e->value = result;
+    e->next = mc->buckets[i];
+    mc->buckets[i] = e;
+    mc->count++;
+    return result;
+}
+
+S_Object *prim_memoize(S_Object **argv, int argc) {
+    (void)argc; // 元数已由描述符统一检查
+    int t = s_type(argv[0]);
+    if (t != S_CLOSURE && t != S_VMCLOSURE && t != S_PROC && t != S_MEMO) {
+        fprintf(stderr, "Error: 'memoize' requires a procedure\n");
+        exit(1);
+    }
+    return s_memo(argv[0]);
+}
+
+// ---- 描述符表 ----
+// 一行一个原语：实现、二元快路径、声明元数、纯度与折叠约束。
+// init_primitives 从这里注册，simplify 的常量折叠也查同一张表。
+static const S_PrimDesc prim_table[] = {
+    // name            fn                  fn2        min max pure div
+    { "+",             prim_add,           prim_add2,  0, -1,  1,  0 },
+    { "-",             prim_sub,           prim_sub2,  1,  2,  1,  0 },
+    { "*",             prim_mul,           prim_mul2,  0, -1,  1,  0 },
+    { "/",             prim_div,           prim_div2,  1,  2,  1,  1 },
+    { "=",             prim_eq,            prim_eq2,   2,  2,  1,  0 },
+    { "<",             prim_lt,            prim_lt2,   2,  2,  1,  0 },
+    { ">",             prim_gt,            prim_gt2,   2,  2,  1,  0 },
+    { "<=",            prim_le,            prim_le2,   2,  2,  1,  0 },
+    { ">=",            prim_ge,            prim_ge2,   2,  2,  1,  0 },
+    { "not",           prim_not,           NULL,       1,  1,  1,  0 },
+    { "memoize",       prim_memoize,       NULL,       1,  1,  0,  0 },
+    { "make-vector",   prim_make_vector,   NULL,       1,  2,  0,  0 },
+    { "vector-length", prim_vector_length, NULL,       1,  1,  0,  0 },
+    { "vector-ref",    prim_vector_ref,    NULL,       2,  2,  0,  0 },
+    { "vector-map",    prim_vector_map,    NULL,       2,  2,  0,  0 },
+    { "vector-sum",    prim_vector_sum,    NULL,       1,  1,  0,  0 },
+    { "vector-add",    prim_vector_add,    NULL,       2,  2,  0,  0 },
+    { "vector-mul",    prim_vector_mul,    NULL,       2,  2,  0,  0 },
+};
+#define PRIM_TABLE_LEN ((int)(sizeof(prim_table) / sizeof(prim_table[0])))
+
+// 分发方在调用前按描述符检查一次元数
+void s_prim_check_arity(const S_PrimDesc *d, int argc) {
+    if (argc < d->min_argc || (d->max_argc != -1 && argc > d->max_argc)) {
+        fprintf(stderr, "Error: '%s': incorrect number of arguments\n", d->name);
+        exit(1);
+    }
+}
+
+// 驻留符号 -> 描述符（simplify 的折叠查询用）。
+// 驻留池线程局部，符号缓存也按线程惰性填充
+const S_PrimDesc *s_prim_lookup(S_Object *sym) {
+    static _Thread_local S_Object *sym_cache[PRIM_TABLE_LEN];
+    for (int i = 0; i < PRIM_TABLE_LEN; i++) {
+        if (!sym_cache[i]) sym_cache[i] = s_symbol(prim_table[i].name);
+        if (sym_cache[i] == sym) return &prim_table[i];
+    }
+    return NULL;
 }
 
 void init_primitives(S_Env *env) {
-    s_env_bind(env, "+", s_proc(prim_add));
-    s_env_bind(env, "-", s_proc(prim_sub));
-    s_env_bind(env, "*", s_proc(prim_mul));
-    s_env_bind(env, "/", s_proc(prim_div));
-    s_env_bind(env, "=", s_proc(prim_eq));
-    s_env_bind(env, "<", s_proc(prim_lt));
-    s_env_bind(env, ">", s_proc(prim_gt));
-    s_env_bind(env, "not", s_proc(prim_not));
-}
\ No newline at end of file
+    for (int i = 0; i < PRIM_TABLE_LEN; i++) {
+        const S_PrimDesc *d = &prim_table[i];
+        s_env_bind(env, s_symbol(d->name), s_proc(d));
+        s_profile_reg_prim(d->name, d->fn); // --profile 按名字报告调用次数
+    }
+}
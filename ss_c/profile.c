@@ -0,0 +1,81 @@
+#include "scheme.h"
+
+// 性能剖析计数器（--profile 启用）。计数内联在各热路径上，
+// 关闭时每处只多一次分支判断；退出前 s_profile_dump 把汇总表
+// 打到 stderr，不污染 stdout 的求值输出。
+
+_Thread_local int s_profile_on = 0;
+_Thread_local S_Profile s_profile;
+
+// 原语调用计数：按函数指针线性匹配（原语总数很小）
+#define PROF_PRIMS_MAX 64
+
+static _Thread_local struct {
+    const char *name;
+    S_PrimFn fn;
+    uint64_t calls;
+} prof_prims[PROF_PRIMS_MAX];
+static _Thread_local int prof_prim_len = 0;
+
+void s_profile_reg_prim(const char *name, S_PrimFn fn) {
+    if (prof_prim_len < PROF_PRIMS_MAX) {
+        prof_prims[prof_prim_len].name = name;
+        prof_prims[prof_prim_len].fn = fn;
+        prof_prims[prof_prim_len].calls = 0;
+        prof_prim_len++;
+    }
+}
+
+void s_profile_prim(S_PrimFn fn) {
+    for (int i = 0; i < prof_prim_len; i++) {
+        if (prof_prims[i].fn == fn) {
+            prof_prims[i].calls++;
+            return;
+        }
+    }
+}
+
+static const char *type_names[] = {
+    "number", "bool", "symbol", "pair", "nil", "proc",
+    "closure", "vmclosure", "localref", "globalref", "vector", "memo", "free"
+};
+
+void s_profile_dump(void) {
+    fprintf(stderr, "---- profile ----\n");
+
+    fprintf(stderr, "evals by expression type:\n");
+    for (int t = 0; t <= S_FREE; t++) {
+        if (s_profile.eval_by_type[t]) {
+            fprintf(stderr, "  %-10s %12llu\n", type_names[t],
+                    (unsigned long long)s_profile.eval_by_type[t]);
+        }
+    }
+
+    fprintf(stderr, "allocations by object type:\n");
+    for (int t = 0; t <= S_FREE; t++) {
+        if (s_profile.alloc_by_type[t]) {
+            fprintf(stderr, "  %-10s %12llu\n", type_names[t],
+                    (unsigned long long)s_profile.alloc_by_type[t]);
+        }
+    }
+    fprintf(stderr, "  %-10s %12llu\n", "env frame",
+            (unsigned long long)s_profile.env_frames);
+
+    fprintf(stderr, "lookup depth (%llu lookups):\n",
+            (unsigned long long)s_profile.lookups);
+    for (int d = 0; d < S_PROF_DEPTH_BUCKETS; d++) {
+        if (s_profile.lookup_depth[d]) {
+            fprintf(stderr, "  %s%-2d       %12llu\n",
+                    d == S_PROF_DEPTH_BUCKETS - 1 ? ">=" : "  ", d,
+                    (unsigned long long)s_profile.lookup_depth[d]);
+        }
+    }
+
+    fprintf(stderr, "primitive calls:\n");
+    for (int i = 0; i < prof_prim_len; i++) {
+        if (prof_prims[i].calls) {
+            fprintf(stderr, "  %-10s %12llu\n", prof_prims[i].name,
+                    (unsigned long long)prof_prims[i].calls);
+        }
+    }
+}
@@ -0,0 +1,226 @@
+#include "scheme.h"
+
+// 词法寻址：lambda 的参数表确定后，体内每个变量引用的坐标
+// (depth, index) 在编译期就已固定。本趟在 simplify 之后运行，把符号
+// 引用改写为 S_LOCALREF（直达帧槽）或 S_GLOBALREF（带内联缓存的
+// 全局槽），scheme_eval 不再按名字逐帧扫描。
+//
+// 保守规则：参数多于 S_ENV_SMALL_CAP（帧会提升为哈希布局，下标不再
+// 稳定）或体内含 define（运行期会添加/遮蔽绑定）的 lambda 视为
+// "不透明"，经过它的引用一律保留原符号，走慢速路径。
+
+typedef struct Scope {
+    S_Object *params; // 参数符号列表
+    int n;
+    int opaque;
+    struct Scope *next;
+} Scope;
+
+static S_Object *mk_localref(S_Object *sym, int depth, int index) {
+    S_Object *ref = s_pair(s_nil(), s_nil()); // 借 s_pair 取对象，改写类型
+    ref->type = S_LOCALREF;
+    ref->val.localref.sym = sym;
+    ref->val.localref.depth = depth;
+    ref->val.localref.index = index;
+    return ref;
+}
+
+static S_Object *mk_globalref(S_Object *sym) {
+    S_Object *ref = s_pair(s_nil(), s_nil());
+    ref->type = S_GLOBALREF;
+    ref->val.gref.sym = sym;
+    ref->val.gref.slot = -1;
+    ref->val.gref.version = 0;
+    return ref;
+}
+
+static int body_contains_define(S_Object *expr) {
+    if (s_type(expr) != S_PAIR) return 0;
+    S_Object *head = s_car(expr);
+    if (s_type(head) == S_SYMBOL && s_sym_special(head) == S_SF_DEFINE) return 1;
+    for (S_Object *p = expr; s_type(p) == S_PAIR; p = s_cdr(p)) {
+        if (body_contains_define(s_car(p))) return 1;
+    }
+    return 0;
+}
+
+// ---- 捕获裁剪 ----
+// 闭包默认挂住整条定义环境链，工厂返回的回调会连同外围帧里它根本
+// 不用的大对象一起留存。对透明的 lambda（自身与全部外围帧都无
+// define、参数不超容量，名字集和槽位编译期可知）收集体内解析到
+// 外围帧的自由变量及其创建期坐标，求值器据此把闭包环境换成只含
+// 这些变量的扁平捕获帧（父帧直指全局环境），留存堆缩到真正被引用
+// 的值，闭包内的查找链也缩短到两层。
+
+typedef struct {
+    S_Object *syms[S_ENV_SMALL_CAP];
+    int depth[S_ENV_SMALL_CAP], index[S_ENV_SMALL_CAP];
+    int n;
+    int give_up; // 自由变量超容量或引用不可靠：放弃裁剪
+} CapSet;
+
+static void cap_add(CapSet *cs, S_Object *sym, int depth, int index) {
+    for (int i = 0; i < cs->n; i++) {
+        if (cs->syms[i] == sym) return;
+    }
+    if (cs->n == S_ENV_SMALL_CAP) { // 捕获帧也要走 s_env_frame 快路径
+        cs->give_up = 1;
+        return;
+    }
+    cs->syms[cs->n] = sym;
+    cs->depth[cs->n] = depth;
+    cs->index[cs->n] = index;
+    cs->n++;
+}
+
+// 收集 expr 中解析到 outer 链的自由变量；inner 是 expr 自身
+// （含嵌套 lambda）的参数作用域链，命中即非自由
+static void collect_free(S_Object *expr, Scope *inner, Scope *outer, CapSet *cs) {
+    if (cs->give_up) return;
+    if (s_type(expr) == S_SYMBOL) {
+        for (Scope *s = inner; s; s = s->next) {
+            for (S_Object *p = s->params; s_type(p) != S_NIL; p = s_cdr(p)) {
+                if (s_car(p) == expr) return; // 本地绑定
+            }
+        }
+        int depth = 0;
+        for (Scope *s = outer; s; s = s->next, depth++) {
+            int index = 0;
+            for (S_Object *p = s->params; s_type(p) != S_NIL;
+                 p = s_cdr(p), index++) {
+                if (s_car(p) == expr) {
+                    if (s->opaque) cs->give_up = 1; // 槽位不稳定，无法快照
+                    else cap_add(cs, expr, depth, index);
+                    return;
+                }
+            }
+            if (s->opaque) { // 运行期可能引入遮蔽
+                cs->give_up = 1;
+                return;
+            }
+        }
+        return; // 全局引用：调用期经 global_env 解析，无需捕获
+    }
+    if (s_type(expr) != S_PAIR) return;
+    S_Object *head = s_car(expr);
+    if (s_type(head) == S_SYMBOL && s_sym_special(head) != S_SF_NONE) {
+        if (s_sym_special(head) == S_SF_LAMBDA) {
+            S_Object *largs = s_cdr(expr);
+            Scope s2 = { s_car(largs), 0, 0, inner };
+            collect_free(s_car(s_cdr(largs)), &s2, outer, cs);
+            return;
+        }
+        if (s_sym_special(head) == S_SF_DEFINE) { // 透明性预检已排除
+            cs->give_up = 1;
+            return;
+        }
+        for (S_Object *p = s_cdr(expr); s_type(p) == S_PAIR; p = s_cdr(p)) {
+            collect_free(s_car(p), inner, outer, cs);
+        }
+        return;
+    }
+    for (S_Object *p = expr; s_type(p) == S_PAIR; p = s_cdr(p)) {
+        collect_free(s_car(p), inner, outer, cs);
+    }
+}
+
+static S_Object *resolve_ref(S_Object *sym, Scope *scope) {
+    int depth = 0;
+    for (Scope *s = scope; s; s = s->next, depth++) {
+        int index = 0;
+        for (S_Object *p = s->params; s_type(p) != S_NIL; p = s_cdr(p), index++) {
+            if (s_car(p) == sym) {
+                return s->opaque ? sym : mk_localref(sym, depth, index);
+            }
+        }
+        if (s->opaque) return sym; // 不透明帧可能在运行期引入遮蔽
+    }
+    return scope ? mk_globalref(sym) : sym; // toplevel 直接求值，无需缓存
+}
+
+static S_Object *resolve(S_Object *expr, Scope *scope) {
+    if (s_type(expr) == S_SYMBOL) return resolve_ref(expr, scope);
+    if (s_type(expr) != S_PAIR) return expr;
+
+    S_Object *head = s_car(expr);
+    S_Object *args = s_cdr(expr);
+
+    if (s_type(head) == S_SYMBOL && s_sym_special(head) != S_SF_NONE) {
+        switch (s_sym_special(head)) {
+        case S_SF_DEFINE: {
+            S_Object *val = resolve(s_car(s_cdr(args)), scope);
+            return s_pair(head, s_pair(s_car(args), s_pair(val, s_nil())));
+        }
+        case S_SF_LAMBDA: {
+            S_Object *params = s_car(args);
+            S_Object *body = s_car(s_cdr(args));
+            Scope inner;
+            inner.params = params;
+            inner.n = 0;
+            for (S_Object *p = params; s_type(p) != S_NIL; p = s_cdr(p)) inner.n++;
+            inner.opaque = inner.n > S_ENV_SMALL_CAP || body_contains_define(body);
+            inner.next = scope;
+
+            // 捕获裁剪：非 toplevel 且自身与全部外围帧透明时才可行
+            int trim = scope != NULL && !inner.opaque;
+            for (Scope *s = scope; trim && s; s = s->next) {
+                if (s->opaque) trim = 0;
+            }
+            CapSet cs = {0};
+            if (trim) {
+                Scope self = { params, inner.n, 0, NULL };
+                collect_free(body, &self, scope, &cs);
+                if (cs.give_up) trim = 0;
+            }
+            if (trim) { // 捕获集覆盖整条外围链时留存集相同，裁剪纯亏
+                int total = 0;
+                for (Scope *s = scope; s; s = s->next) total += s->n;
+                if (cs.n == total) trim = 0;
+            }
+            if (trim) {
+                // 体内引用改以 [本帧, 捕获帧] 为坐标系重新解析；
+                // 捕获表记录各自由变量的创建期坐标，供求值器快照取值
+                S_Object *cap_syms = s_nil();
+                S_Object *cap_refs = s_nil();
+                for (int i = cs.n - 1; i >= 0; i--) { // 倒序头插保持下标顺序
+                    cap_syms = s_pair(cs.syms[i], cap_syms);
+                    cap_refs = s_pair(
+                        mk_localref(cs.syms[i], cs.depth[i], cs.index[i]),
+                        cap_refs);
+                }
+                Scope capscope = { cap_syms, cs.n, 0, NULL };
+                inner.next = &capscope;
+                body = resolve(body, &inner);
+                return s_pair(head, s_pair(params,
+                              s_pair(body, s_pair(cap_refs, s_nil()))));
+            }
+
+            body = resolve(body, &inner);
+            return s_pair(head, s_pair(params, s_pair(body, s_nil())));
+        }
+        default: { // if/and/or：逐项解析
+            S_Object *resolved = s_nil();
+            S_Object **tail = &resolved;
+            for (S_Object *p = args; s_type(p) != S_NIL; p = s_cdr(p)) {
+                S_Object *pair = s_pair(resolve(s_car(p), scope), s_nil());
+                *tail = pair;
+                tail = &pair->val.pair.cdr;
+            }
+            return s_pair(head, resolved);
+        }
+        }
+    }
+
+    S_Object *resolved = s_nil();
+    S_Object **tail = &resolved;
+    for (S_Object *p = expr; s_type(p) != S_NIL; p = s_cdr(p)) {
+        S_Object *pair = s_pair(resolve(s_car(p), scope), s_nil());
+        *tail = pair;
+        tail = &pair->val.pair.cdr;
+    }
+    return resolved;
+}
+
+S_Object *scheme_resolve(S_Object *expr) {
+    return resolve(expr, NULL);
+}
@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 
 // Scheme 对象类型
 enum {
@@ -13,16 +14,85 @@ enum {
     S_PAIR,
     S_NIL,
     S_PROC,
-    S_CLOSURE
+    S_CLOSURE,
+    S_VMCLOSURE, // body 字段存放 vm.c 的 S_Chunk*，仅由 VM 应用
+    S_LOCALREF,  // 词法寻址后的局部变量引用（depth, index）
+    S_GLOBALREF, // 带内联缓存的全局变量引用
+    S_VECTOR,    // 连续 double 数组，数值批处理不再逐元素追指针
+    S_MEMO,      // (memoize f)：带实参键缓存的过程包装
+    S_FREE // 内部：空闲链上的对象（仅 GC 使用）
 };
 
-// Scheme 对象结构体
+// NaN-boxing：S_Object* 实际上是一个 64 位编码字，并不总是指针。
+//  - 数字：存放 double 的 IEEE 位模式加上偏移 2^49，因此编码后恒 >= 2^49
+//   （硬件只产生 0x7ff8/0xfff8 型 NaN，加偏移不会回绕）；
+//  - 堆对象（pair/closure/symbol/proc）：原始指针，恒 < 2^49 且 8 字节对齐；
+//  - 定点数（fixnum）：低 3 位为 0b001，载荷是 46 位带符号整数
+//    （编码字须保持 < 2^49，不与浮点编码冲突）；
+//  - 其他立即数：低 3 位非零的小整数，编码 nil、#f、#t。
+// 因此数字、布尔和 nil 不占堆、没有 ref_count、无需 s_dec_ref。
+// 整数值一律规范化为定点编码（s_number 负责），同值必同码，
+// 整数主导的负载全程走整数 ALU，溢出/超范围才提升为 double。
+#define S_NUM_OFFSET (1ULL << 49)
+#define S_MK_IMM(x)  ((S_Object*)(uint64_t)(x))
+#define S_FIX_TAG 0x1
+#define S_FIX_MAX ((int64_t)1 << 45) // 不含
+#define S_FIX_MIN (-((int64_t)1 << 45))
+
+// 特殊形式关键字 ID：驻留符号时一次性判定，
+// 求值热路径上用整数 switch 分发，不再逐个 strcmp
+enum {
+    S_SF_NONE = 0,
+    S_SF_IF,
+    S_SF_DEFINE,
+    S_SF_LAMBDA,
+    S_SF_AND,
+    S_SF_OR
+};
+
+// 原语调用约定：实参在求值器的参数栈上连续排列，原语收到
+// (argv, argc)，不再为每次调用 cons 出链表、也不再为计数重走一遍
+typedef struct S_Object *(*S_PrimFn)(struct S_Object **argv, int argc);
+typedef struct S_Object *(*S_PrimFn2)(struct S_Object *a, struct S_Object *b);
+
+// 原语描述符：名字、实现、声明元数和（若有）二实参免数组直调变体。
+// init_primitives 从静态表注册；求值器按描述符一次性查元数，
+// simplify 的常量折叠也从同一张表读纯度与除零约束
+typedef struct S_PrimDesc {
+    const char *name;
+    S_PrimFn fn;
+    S_PrimFn2 fn2;          // argc==2 的快路径，可为 NULL
+    int min_argc, max_argc; // max -1 表示不限
+    int pure;               // 无副作用，常量实参可折叠
+    int div_guard;          // 折叠前须确认不会除零
+} S_PrimDesc;
+
+const S_PrimDesc *s_prim_lookup(struct S_Object *sym); // 驻留符号 -> 描述符
+void s_prim_check_arity(const S_PrimDesc *d, int argc);
+
+// 备忘缓存（memoize）：实参编码字序列做键的拉链哈希。
+// 数字已规范化（同值同码），键比较就是逐字相等
+typedef struct S_MemoEntry {
+    struct S_Object **args;
+    int argc;
+    struct S_Object *value;
+    struct S_MemoEntry *next;
+} S_MemoEntry;
+
+typedef struct S_MemoCache {
+    S_MemoEntry **buckets;
+    size_t cap;
+    size_t count;
+} S_MemoCache;
+
+// 堆上对象的结构体（只有 pair/closure/symbol/proc 落在堆上）
 typedef struct S_Object {
     int type;
     union {
-        double num_val;
-        int bool_val;
-        char *sym_val;
+        struct {
+            char *name;
+            int special; // S_SF_*，普通符号为 S_SF_NONE
+        } sym;
         struct {
             struct S_Object *car;
             struct S_Object *cdr;
@@ -30,50 +100,193 @@ typedef struct S_Object {
         struct {
             struct S_Object *params;
             struct S_Object *body;
-            struct S_Object *env;
+            struct S_Env *env;
         } closure;
-        struct S_Object* (*prim_proc)(struct S_Object* args);
+        const S_PrimDesc *prim; // 原语描述符（prim.c 的静态表）
+        struct {
+            struct S_Object *sym; // 供出错信息和回退查找
+            int depth, index;
+        } localref;
+        struct {
+            struct S_Object *sym;
+            int slot;         // 全局帧中的值槽下标
+            uint32_t version; // 槽位所属的全局帧版本
+        } gref;
+        struct {
+            double *data;
+            int len;
+        } vec;
+        struct {
+            struct S_Object *proc; // 被包装的过程
+            S_MemoCache *cache;
+        } memo;
     } val;
-    // 简单的引用计数（可选）
-    int ref_count;
+    int gc_mark; // GC 标记位
 } S_Object;
 
-// 环境
+#define S_NIL_V   S_MK_IMM(0x2)
+#define S_FALSE_V S_MK_IMM(0x6)
+#define S_TRUE_V  S_MK_IMM(0xE)
+
+static inline int s_is_fixnum(S_Object *v) {
+    // 偏移后的装箱 double 也可能低 3 位恰为 0b001，必须先以
+    // S_NUM_OFFSET 划界：定点编码只占 [0, 2^49) 区间
+    return (uint64_t)v < S_NUM_OFFSET && ((uint64_t)v & 0x7) == S_FIX_TAG;
+}
+
+static inline int64_t s_fix_val(S_Object *v) {
+    return (int64_t)((uint64_t)v << 15) >> 18; // 载荷移顶后算术右移补符号
+}
+
+static inline S_Object *s_fixnum(int64_t v) { // 调用方保证范围
+    return S_MK_IMM((((uint64_t)v << 3) & (S_NUM_OFFSET - 1)) | S_FIX_TAG);
+}
+
+static inline int s_is_number(S_Object *v) {
+    return (uint64_t)v >= S_NUM_OFFSET || s_is_fixnum(v);
+}
+
+static inline int s_is_heap(S_Object *v) {
+    return !s_is_number(v) && ((uint64_t)v & 0x7) == 0;
+}
+
+static inline int s_type(S_Object *v) {
+    if (s_is_number(v)) return S_NUMBER;
+    if (((uint64_t)v & 0x7) == 0) return v->type;
+    return v == S_NIL_V ? S_NIL : S_BOOL;
+}
+
+static inline double s_num_val(S_Object *v) {
+    if (s_is_fixnum(v)) return (double)s_fix_val(v);
+    union { uint64_t u; double d; } c;
+    c.u = (uint64_t)v - S_NUM_OFFSET;
+    return c.d;
+}
+
+static inline int s_bool_val(S_Object *v) { return v == S_TRUE_V; }
+static inline int s_is_true(S_Object *v) { return v != S_FALSE_V; } // 除 #f 外皆真
+
+static inline S_Object *s_car(S_Object *v) { return v->val.pair.car; }
+static inline S_Object *s_cdr(S_Object *v) { return v->val.pair.cdr; }
+static inline const char *s_sym_name(S_Object *v) { return v->val.sym.name; }
+static inline int s_sym_special(S_Object *v) { return v->val.sym.special; }
+static inline double *s_vec_data(S_Object *v) { return v->val.vec.data; }
+static inline int s_vec_len(S_Object *v) { return v->val.vec.len; }
+
+// 环境帧：绑定存放在 syms/vals 平行数组中。
+// 小帧（lambda 参数）线性扫描即可；超过 S_ENV_SMALL_CAP 后
+// 提升为开放寻址哈希表（驻留符号按指针哈希），查找 O(1)。
+#define S_ENV_SMALL_CAP 8
+
 typedef struct S_Env {
-    S_Object *bindings;
+    S_Object **syms; // NULL 表示空槽（哈希模式）
+    S_Object **vals;
+    int count;
+    int cap; // cap <= S_ENV_SMALL_CAP 时为线性模式，否则为哈希模式
     struct S_Env *parent;
+    struct S_Env *gc_next; // 环境注册链，供 GC 清扫
+    int gc_mark;
+    uint32_t version; // 扩容时递增，失效指向本帧的内联缓存
 } S_Env;
 
-// 全局环境
-extern S_Env *global_env;
+// 全局环境（线程局部：每个线程就是一个独立的解释器实例）
+extern _Thread_local S_Env *global_env;
 
 // 数据类型函数
 S_Object *s_number(double num);
+S_Object *s_int(int64_t v); // 定点优先，超出 fixnum 范围回退 double
 S_Object *s_bool(int b);
 S_Object *s_symbol(const char *sym);
 S_Object *s_pair(S_Object *car, S_Object *cdr);
-S_Object *s_proc(S_Object* (*proc)(S_Object*));
-S_Object *s_closure(S_Object *params, S_Object *body, S_Object *env);
+S_Object *s_proc(const S_PrimDesc *desc);
+S_Object *s_closure(S_Object *params, S_Object *body, S_Env *env);
+S_Object *s_vector(int len); // 元素清零
+S_Object *s_memo(S_Object *proc);
 S_Object *s_nil();
 
-// 内存管理
-void s_free(S_Object *obj);
-void s_inc_ref(S_Object *obj);
-void s_dec_ref(S_Object *obj);
+// 内存管理：标记-清扫 GC。根是 global_env；在 toplevel 表达式之间的
+// 安全点调用 s_gc_maybe_collect（求值中途不触发回收）。
+void s_gc_mark(S_Object *obj);
+void s_gc_collect(void);
+void s_gc_maybe_collect(void);
+extern _Thread_local S_Object *s_gc_roots; // 额外根：预编译镜像中尚未执行的形式链
 
 // 解析器
 S_Object *scheme_parse(const char *str);
 S_Object *scheme_read(FILE *stream);
+void scheme_read_end(FILE *stream); // 解除读取器与 stream 的绑定
+
+// 预编译 AST 镜像（image.c，-c 生成，process_file 按魔数识别）
+int scheme_image_check(FILE *fp); // 消耗魔数返回 1；否则回绕返回 0
+void scheme_image_write(const char *in_path, const char *out_path);
+S_Object *scheme_image_load(FILE *fp); // 返回 toplevel 形式链表
+
+// 求值前的常量折叠与化简（simplify.c）
+S_Object *scheme_simplify(S_Object *expr);
+
+// 变量引用的词法寻址与内联缓存标注（resolve.c，树遍历引擎使用）
+S_Object *scheme_resolve(S_Object *expr);
 
 // 求值器
 S_Object *scheme_eval(S_Object *expr, S_Env *env);
+// 从原语回调用户过程（vector-map 等），按当前引擎分发
+S_Object *scheme_apply(S_Object *proc, S_Object **argv, int argc);
+// 备忘包装的调用入口（prim.c）：查缓存，未命中才真正应用
+S_Object *s_memo_call(S_Object *memo, S_Object **argv, int argc);
+
+// 字节码虚拟机（vm.c，--vm 启用）
+S_Object *scheme_vm_eval(S_Object *expr, S_Env *env);
+S_Object *scheme_vm_apply(S_Object *proc, S_Object **argv, int argc);
+void scheme_vm_mark_chunk(void *chunk); // 标记 chunk 引用的参数列表
+
+// 性能剖析计数器（profile.c，--profile 启用）。
+// 热路径上的增量都以 s_profile_on 为条件，关闭时近乎零开销。
+#define S_PROF_DEPTH_BUCKETS 17 // 最后一桶收纳 >=16 层的查找
+
+typedef struct {
+    uint64_t eval_by_type[S_FREE + 1];
+    uint64_t alloc_by_type[S_FREE + 1];
+    uint64_t env_frames;
+    uint64_t lookups;
+    uint64_t lookup_depth[S_PROF_DEPTH_BUCKETS];
+} S_Profile;
 
-// 打印
+extern _Thread_local int s_profile_on;
+extern _Thread_local S_Profile s_profile;
+void s_profile_reg_prim(const char *name, S_PrimFn fn);
+void s_profile_prim(S_PrimFn fn); // 记一次原语调用
+void s_profile_dump(void);
+
+// 打印（write.c：带缓冲的输出层，渲染进缓冲区后整块写出）
 void scheme_print(S_Object *obj);
+void scheme_write(const char *s); // 追加一段原样文本
+void scheme_write_flush(void);    // 冲刷输出缓冲到 stdout
+
+// 原语注册（prim.c）
+void init_primitives(S_Env *env);
+
+// 嵌入 API（context.c，libscheme.a 的入口）。解释器的全部可变状态
+// （分配器、驻留池、GC、各引擎栈）都是线程局部量：每个线程经
+// scheme_context_new 取得一份独立解释器，多线程嵌入零加锁。
+// 对象和符号归创建它们的上下文所有，不可跨线程传递。
+typedef struct S_Context {
+    S_Env *env; // 本上下文的全局环境（即本线程的 global_env）
+    S_Object *last_result; // 上一次 eval_string 的返回值，作为 GC 根保活
+} S_Context;
+
+S_Context *scheme_context_new(void);
+void scheme_context_destroy(S_Context *ctx);
+S_Object *scheme_context_eval(S_Context *ctx, S_Object *expr);
+// 返回值生命周期：eval_string 的返回值作为 GC 根保活，并在下一次
+// eval_string 调用期间继续有效，直到那次调用返回并把根换成新结果；
+// 要跨更多次调用持有结果，宿主需把值绑定进全局环境（define）
+S_Object *scheme_context_eval_string(S_Context *ctx, const char *src);
 
-// 环境操作
+// 环境操作（sym 必须是 s_symbol 返回的驻留符号，按指针比较）
 S_Env *s_env_new(S_Env *parent);
-S_Object *s_env_find(S_Env *env, const char *sym);
-void s_env_bind(S_Env *env, const char *sym, S_Object *val);
+S_Env *s_env_frame(S_Env *parent, int n); // 单次分配的调用帧，槽位按参数序填充
+S_Object *s_env_find(S_Env *env, S_Object *sym);
+int s_env_slot(S_Env *env, S_Object *sym); // 仅查本帧，返回槽下标或 -1
+void s_env_bind(S_Env *env, S_Object *sym, S_Object *val);
 
 #endif // SCHEME_H
\ No newline at end of file
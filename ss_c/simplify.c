@@ -0,0 +1,159 @@
+#include "scheme.h"
+
+// 求值前的常量折叠与化简：在 scheme_read 之后对表达式树跑一遍，
+// 折叠全常量的算术调用（复用 prim.c 的实现）、坍缩常量 if/and/or
+// 并丢弃死分支。闭包体随 lambda 一起被化简，代价只付一次。
+
+// 折叠直接复用 prim.c 的描述符表（s_prim_lookup）：纯度、元数和
+// 除零约束都声明在描述符上。= 和 not 的实参类型特例仍按函数指针识别
+extern S_Object *prim_eq(S_Object **argv, int argc);
+extern S_Object *prim_not(S_Object **argv, int argc);
+
+// 被 lambda 参数遮蔽的符号，沿递归以链表携带
+typedef struct Shadow {
+    S_Object *sym;
+    struct Shadow *next;
+} Shadow;
+
+static int is_shadowed(Shadow *s, S_Object *sym) {
+    for (; s; s = s->next) {
+        // sym 为 NULL 的哨兵遮蔽一切（参数超出跟踪容量的 lambda 体）
+        if (!s->sym || s->sym == sym) return 1;
+    }
+    return 0;
+}
+
+// 用户在 toplevel 重定义过的原语名：之后不再折叠该符号
+#define MAX_REDEFINED 32
+static _Thread_local S_Object *redefined[MAX_REDEFINED];
+static _Thread_local int redefined_len = 0;
+
+static const S_PrimDesc *find_foldable(S_Object *sym) {
+    const S_PrimDesc *d = s_prim_lookup(sym);
+    if (!d || !d->pure) return NULL;
+    for (int j = 0; j < redefined_len; j++) {
+        if (redefined[j] == sym) return NULL;
+    }
+    return d;
+}
+
+static int is_const(S_Object *v) {
+    int t = s_type(v);
+    return t == S_NUMBER || t == S_BOOL;
+}
+
+static S_Object *simplify(S_Object *expr, Shadow *shadow);
+
+// 常量实参齐备时折叠调用；任何会在运行期报错的情况都放弃折叠
+#define FOLD_MAX_ARGS 16
+
+static S_Object *try_fold_call(const S_PrimDesc *f, S_Object *args) {
+    S_Object *argv[FOLD_MAX_ARGS];
+    int argc = 0;
+    for (S_Object *p = args; s_type(p) != S_NIL; p = s_cdr(p)) {
+        S_Object *arg = s_car(p);
+        if (argc == FOLD_MAX_ARGS) return NULL;
+        if (!is_const(arg)) return NULL;
+        if (f->fn != prim_eq && f->fn != prim_not && !s_is_number(arg)) return NULL;
+        if (f->fn == prim_not && s_type(arg) != S_BOOL) return NULL;
+        if (f->div_guard && argc == 1 && s_num_val(arg) == 0.0) return NULL;
+        argv[argc++] = arg;
+    }
+    if (argc < f->min_argc || (f->max_argc != -1 && argc > f->max_argc)) return NULL;
+    if (f->div_guard && argc == 1 && s_num_val(argv[0]) == 0.0) return NULL;
+    return f->fn(argv, argc);
+}
+
+static S_Object *simplify(S_Object *expr, Shadow *shadow) {
+    if (s_type(expr) != S_PAIR) return expr;
+
+    S_Object *head = s_car(expr);
+    S_Object *args = s_cdr(expr);
+
+    if (s_type(head) == S_SYMBOL && s_sym_special(head) != S_SF_NONE) {
+        switch (s_sym_special(head)) {
+        case S_SF_IF: {
+            S_Object *test = simplify(s_car(args), shadow);
+            if (is_const(test)) { // 常量条件：只留被选中的分支
+                S_Object *branch = s_is_true(test) ? s_car(s_cdr(args))
+                                                   : s_car(s_cdr(s_cdr(args)));
+                return simplify(branch, shadow);
+            }
+            S_Object *conseq = simplify(s_car(s_cdr(args)), shadow);
+            S_Object *alt = simplify(s_car(s_cdr(s_cdr(args))), shadow);
+            return s_pair(head, s_pair(test, s_pair(conseq, s_pair(alt, s_nil()))));
+        }
+        case S_SF_DEFINE: {
+            S_Object *sym = s_car(args);
+            if (find_foldable(sym) && redefined_len < MAX_REDEFINED) {
+                redefined[redefined_len++] = sym; // 原语被重定义，此后放弃折叠
+            }
+            S_Object *val = simplify(s_car(s_cdr(args)), shadow);
+            return s_pair(head, s_pair(sym, s_pair(val, s_nil())));
+        }
+        case S_SF_LAMBDA: {
+            Shadow local[9]; // 参数遮蔽原语名时体内不折叠
+            Shadow *sh = shadow;
+            int n = 0;
+            for (S_Object *p = s_car(args); s_type(p) != S_NIL; p = s_cdr(p)) {
+                if (n < 8) {
+                    local[n].sym = s_car(p);
+                } else if (n == 8) {
+                    // 超出跟踪容量：体内放弃一切折叠，而非漏掉后续参数
+                    //（与 resolve.c 对大参数帧按不透明处理一致）
+                    local[n].sym = NULL;
+                } else {
+                    break;
+                }
+                local[n].next = sh;
+                sh = &local[n++];
+            }
+            S_Object *body = simplify(s_car(s_cdr(args)), sh);
+            return s_pair(head, s_pair(s_car(args), s_pair(body, s_nil())));
+        }
+        case S_SF_AND:
+        case S_SF_OR: {
+            S_Object *simplified = s_nil();
+            S_Object **tail = &simplified;
+            int all_const = 1;
+            for (S_Object *p = args; s_type(p) != S_NIL; p = s_cdr(p)) {
+                S_Object *e = simplify(s_car(p), shadow);
+                if (!is_const(e)) all_const = 0;
+                S_Object *pair = s_pair(e, s_nil());
+                *tail = pair;
+                tail = &pair->val.pair.cdr;
+            }
+            if (all_const) { // 全常量才折叠，保持短路求值的可见行为
+                int is_and = (s_sym_special(head) == S_SF_AND);
+                for (S_Object *p = simplified; s_type(p) != S_NIL; p = s_cdr(p)) {
+                    if (is_and && !s_is_true(s_car(p))) return S_FALSE_V;
+                    if (!is_and && s_is_true(s_car(p))) return S_TRUE_V;
+                }
+                return is_and ? S_TRUE_V : S_FALSE_V;
+            }
+            return s_pair(head, simplified);
+        }
+        }
+    }
+
+    // 普通调用：先化简各子表达式，再尝试折叠纯原语
+    S_Object *simplified = s_nil();
+    S_Object **tail = &simplified;
+    for (S_Object *p = args; s_type(p) != S_NIL; p = s_cdr(p)) {
+        S_Object *pair = s_pair(simplify(s_car(p), shadow), s_nil());
+        *tail = pair;
+        tail = &pair->val.pair.cdr;
+    }
+    if (s_type(head) == S_SYMBOL && !is_shadowed(shadow, head)) {
+        const S_PrimDesc *f = find_foldable(head);
+        if (f) {
+            S_Object *folded = try_fold_call(f, simplified);
+            if (folded) return folded;
+        }
+    }
+    return s_pair(simplify(head, shadow), simplified);
+}
+
+S_Object *scheme_simplify(S_Object *expr) {
+    return simplify(expr, NULL);
+}
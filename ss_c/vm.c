@@ -0,0 +1,400 @@
+#include "scheme.h"
+
+// 字节码编译器 + 线程式分发虚拟机（--vm 启用）。
+// 每个 toplevel 表达式和每个 lambda 体编译为一个 S_Chunk：
+// 常量池 + 扁平指令数组（操作数内联其后）。解释循环用 computed goto
+// 直接跳转，省掉树遍历的指针追逐和特殊形式的 strcmp 分发。
+
+enum {
+    OP_CONST,    // 操作数：常量池下标
+    OP_GETVAR,   // 操作数：常量池下标（驻留符号）
+    OP_DEFINE,   // 操作数：常量池下标；弹出值绑定到当前环境，压入"无值"
+    OP_CLOSURE,  // 操作数：子 chunk 下标；捕获当前环境
+    OP_JUMP,     // 操作数：绝对目标
+    OP_JFALSE,   // 操作数：绝对目标；弹出栈顶，#f 则跳转
+    OP_CALL,     // 操作数：实参个数；栈上为 [proc, arg1..argN]
+    OP_TAILCALL, // 同上，但复用当前帧
+    OP_RETURN
+};
+
+typedef struct S_Chunk {
+    int *code;
+    int code_len, code_cap;
+    S_Object **consts;
+    int const_len, const_cap;
+    struct S_Chunk **subs; // lambda 子 chunk
+    S_Object **sub_params; // 与 subs 对应的参数列表
+    int sub_len, sub_cap;
+} S_Chunk;
+
+// ---- 编译 ----
+
+static S_Chunk *chunk_new() {
+    S_Chunk *c = calloc(1, sizeof(S_Chunk));
+    return c;
+}
+
+static int chunk_emit(S_Chunk *c, int word) {
+    if (c->code_len == c->code_cap) {
+        c->code_cap = c->code_cap ? c->code_cap * 2 : 32;
+        c->code = realloc(c->code, c->code_cap * sizeof(int));
+    }
+    c->code[c->code_len] = word;
+    return c->code_len++;
+}
+
+static int chunk_const(S_Chunk *c, S_Object *v) {
+    for (int i = 0; i < c->const_len; i++) {
+        if (c->consts[i] == v) return i; // 驻留符号/立即数去重
+    }
+    if (c->const_len == c->const_cap) {
+        c->const_cap = c->const_cap ? c->const_cap * 2 : 8;
+        c->consts = realloc(c->consts, c->const_cap * sizeof(S_Object*));
+    }
+    c->consts[c->const_len] = v;
+    return c->const_len++;
+}
+
+// 释放 chunk 树（子 chunk 归属父 chunk）。只能在确认没有 VMCLOSURE
+// 引用树中任何 chunk 时调用，见 scheme_vm_eval
+static void chunk_free(S_Chunk *c) {
+    for (int i = 0; i < c->sub_len; i++) chunk_free(c->subs[i]);
+    free(c->code);
+    free(c->consts);
+    free(c->subs);
+    free(c->sub_params);
+    free(c);
+}
+
+static int chunk_sub(S_Chunk *c, S_Chunk *sub, S_Object *params) {
+    if (c->sub_len == c->sub_cap) {
+        c->sub_cap = c->sub_cap ? c->sub_cap * 2 : 4;
+        c->subs = realloc(c->subs, c->sub_cap * sizeof(S_Chunk*));
+        c->sub_params = realloc(c->sub_params, c->sub_cap * sizeof(S_Object*));
+    }
+    c->subs[c->sub_len] = sub;
+    c->sub_params[c->sub_len] = params;
+    return c->sub_len++;
+}
+
+static void compile_expr(S_Chunk *c, S_Object *expr, int tail);
+
+static int list_len(S_Object *p) {
+    int n = 0;
+    while (s_type(p) != S_NIL) { n++; p = s_cdr(p); }
+    return n;
+}
+
+static void compile_expr(S_Chunk *c, S_Object *expr, int tail) {
+    switch (s_type(expr)) {
+        case S_NUMBER:
+        case S_BOOL:
+        case S_NIL:
+            chunk_emit(c, OP_CONST);
+            chunk_emit(c, chunk_const(c, expr));
+            return;
+        case S_SYMBOL:
+            chunk_emit(c, OP_GETVAR);
+            chunk_emit(c, chunk_const(c, expr));
+            return;
+        case S_PAIR:
+            break;
+        default:
+            fprintf(stderr, "Error: invalid expression\n");
+            exit(1);
+    }
+
+    S_Object *head = s_car(expr);
+    S_Object *args = s_cdr(expr);
+
+    if (s_type(head) == S_SYMBOL && s_sym_special(head) != S_SF_NONE) {
+        int sf = s_sym_special(head);
+        if (sf == S_SF_IF) {
+            compile_expr(c, s_car(args), 0);
+            chunk_emit(c, OP_JFALSE);
+            int jf = chunk_emit(c, 0);
+            compile_expr(c, s_car(s_cdr(args)), tail);
+            chunk_emit(c, OP_JUMP);
+            int jend = chunk_emit(c, 0);
+            c->code[jf] = c->code_len;
+            compile_expr(c, s_car(s_cdr(s_cdr(args))), tail);
+            c->code[jend] = c->code_len;
+            return;
+        }
+        if (sf == S_SF_DEFINE) {
+            compile_expr(c, s_car(s_cdr(args)), 0);
+            chunk_emit(c, OP_DEFINE);
+            chunk_emit(c, chunk_const(c, s_car(args)));
+            return;
+        }
+        if (sf == S_SF_LAMBDA) {
+            S_Chunk *sub = chunk_new();
+            compile_expr(sub, s_car(s_cdr(args)), 1);
+            chunk_emit(sub, OP_RETURN);
+            chunk_emit(c, OP_CLOSURE);
+            chunk_emit(c, chunk_sub(c, sub, s_car(args)));
+            return;
+        }
+        if (sf == S_SF_AND || sf == S_SF_OR) {
+            // (and a b ...)：任一为 #f 即短路；or 对偶
+            int is_and = (sf == S_SF_AND);
+            int n = list_len(args);
+            int *jumps = malloc(n * sizeof(int));
+            S_Object *p = args;
+            for (int i = 0; i < n; i++) {
+                compile_expr(c, s_car(p), 0);
+                if (is_and) {
+                    chunk_emit(c, OP_JFALSE);
+                    jumps[i] = chunk_emit(c, 0);
+                } else {
+                    // or：真则短路。先取反语义用 JFALSE 继续尝试下一项
+                    chunk_emit(c, OP_JFALSE);
+                    int next = chunk_emit(c, 0);
+                    chunk_emit(c, OP_CONST);
+                    chunk_emit(c, chunk_const(c, S_TRUE_V));
+                    chunk_emit(c, OP_JUMP);
+                    jumps[i] = chunk_emit(c, 0);
+                    c->code[next] = c->code_len;
+                }
+                p = s_cdr(p);
+            }
+            chunk_emit(c, OP_CONST);
+            chunk_emit(c, chunk_const(c, is_and ? S_TRUE_V : S_FALSE_V));
+            if (is_and) {
+                chunk_emit(c, OP_JUMP);
+                int jend = chunk_emit(c, 0);
+                for (int i = 0; i < n; i++) c->code[jumps[i]] = c->code_len;
+                chunk_emit(c, OP_CONST);
+                chunk_emit(c, chunk_const(c, S_FALSE_V));
+                c->code[jend] = c->code_len;
+            } else {
+                for (int i = 0; i < n; i++) c->code[jumps[i]] = c->code_len;
+            }
+            free(jumps);
+            return;
+        }
+    }
+
+    // 普通应用：先求值算子，再依次求值实参
+    compile_expr(c, head, 0);
+    int argc = 0;
+    for (S_Object *p = args; s_type(p) != S_NIL; p = s_cdr(p)) {
+        compile_expr(c, s_car(p), 0);
+        argc++;
+    }
+    chunk_emit(c, tail ? OP_TAILCALL : OP_CALL);
+    chunk_emit(c, argc);
+}
+
+// ---- 执行 ----
+
+#define VM_STACK_MAX 65536
+#define VM_FRAMES_MAX 16384
+
+typedef struct {
+    S_Chunk *chunk;
+    int ip;
+    S_Env *env;
+    int base; // 栈基址，RETURN 时收缩到此处
+} VM_Frame;
+
+// 值栈与帧栈跨 vm_run 调用共享：原语回调用户过程（scheme_vm_apply）
+// 会重入 vm_run，嵌套调用从上次发布的水位之上继续使用同一对栈
+// 两个栈线程局部但惰性分配：不进 VM 的线程不掏这 1MB
+static _Thread_local S_Object **stack = NULL;
+static _Thread_local VM_Frame *frames = NULL;
+static _Thread_local int vm_sp = 0, vm_fp = 0;
+static _Thread_local long vm_closures_made = 0; // 见 scheme_vm_eval
+
+static S_Object *vm_run(S_Chunk *chunk, S_Env *env) {
+    if (!stack) {
+        stack = malloc(VM_STACK_MAX * sizeof(S_Object*));
+        frames = malloc(VM_FRAMES_MAX * sizeof(VM_Frame));
+    }
+    int base_sp = vm_sp, base_fp = vm_fp;
+    int sp = base_sp, fp = base_fp;
+    frames[fp] = (VM_Frame){ chunk, 0, env, sp };
+
+    static void *dispatch[] = {
+        &&do_const, &&do_getvar, &&do_define, &&do_closure,
+        &&do_jump, &&do_jfalse, &&do_call, &&do_tailcall, &&do_return
+    };
+
+    VM_Frame *f = &frames[fp];
+    #define NEXT goto *dispatch[f->chunk->code[f->ip++]]
+    #define OPERAND (f->chunk->code[f->ip++])
+    // 值栈不可搬家（重入的外层调用持有指向栈内的 argv），越界只能报错
+    #define PUSH(x) do { \
+        if (sp == VM_STACK_MAX) { \
+            fprintf(stderr, "Error: vm value stack overflow\n"); \
+            exit(1); \
+        } \
+        stack[sp++] = (x); \
+    } while (0)
+    NEXT;
+
+do_const:
+    PUSH(f->chunk->consts[OPERAND]);
+    NEXT;
+
+do_getvar:
+    PUSH(s_env_find(f->env, f->chunk->consts[OPERAND]));
+    NEXT;
+
+do_define:
+    s_env_bind(f->env, f->chunk->consts[OPERAND], stack[--sp]);
+    PUSH(NULL); // define 不产生值
+    NEXT;
+
+do_closure: {
+    int i = OPERAND;
+    // body 字段存放子 chunk；该闭包只会被 VM 应用
+    vm_closures_made++;
+    S_Object *clo = s_closure(f->chunk->sub_params[i], s_nil(), f->env);
+    clo->type = S_VMCLOSURE;
+    clo->val.closure.body = (S_Object*)f->chunk->subs[i];
+    PUSH(clo);
+    NEXT;
+}
+
+do_jump:
+    f->ip = f->chunk->code[f->ip];
+    NEXT;
+
+do_jfalse: {
+    int target = OPERAND;
+    if (!s_is_true(stack[--sp])) f->ip = target;
+    NEXT;
+}
+
+do_call:
+do_tailcall: {
+    int is_tail = (f->chunk->code[f->ip - 1] == OP_TAILCALL);
+    int argc = OPERAND;
+    S_Object **argv = &stack[sp - argc];
+    S_Object *proc = stack[sp - argc - 1];
+
+    if (s_type(proc) == S_PROC) { // 实参已在 VM 栈上连续，直接传数组
+        const S_PrimDesc *d = proc->val.prim;
+        s_prim_check_arity(d, argc);
+        if (s_profile_on) s_profile_prim(d->fn);
+        vm_sp = sp; // 发布水位：原语可能经 scheme_vm_apply 重入 VM
+        vm_fp = fp + 1;
+        S_Object *result = (argc == 2 && d->fn2) ? d->fn2(argv[0], argv[1])
+                                                 : d->fn(argv, argc);
+        sp -= argc + 1;
+        PUSH(result);
+        NEXT;
+    }
+    if (s_type(proc) == S_MEMO) { // 备忘包装：同原语约定，未命中时重入引擎
+        vm_sp = sp;
+        vm_fp = fp + 1;
+        S_Object *result = s_memo_call(proc, argv, argc);
+        sp -= argc + 1;
+        PUSH(result);
+        NEXT;
+    }
+    if (s_type(proc) != S_VMCLOSURE) {
+        fprintf(stderr, "Error: not a procedure\n");
+        exit(1);
+    }
+
+    S_Env *call_env;
+    S_Object *p = proc->val.closure.params;
+    if (argc <= S_ENV_SMALL_CAP) { // 实参已在栈上连续，整帧一次分配
+        call_env = s_env_frame(proc->val.closure.env, argc);
+        int i = 0;
+        for (; i < argc && s_type(p) != S_NIL; i++, p = s_cdr(p)) {
+            call_env->syms[i] = s_car(p);
+            call_env->vals[i] = argv[i];
+            call_env->count++;
+        }
+        // 实参多于形参时清空余下槽位：回收帧的陈旧指针会被 GC 标记误走
+        for (; i < argc; i++) call_env->syms[i] = NULL;
+    } else {
+        call_env = s_env_new(proc->val.closure.env);
+        for (int i = 0; i < argc && s_type(p) != S_NIL; i++, p = s_cdr(p)) {
+            s_env_bind(call_env, s_car(p), argv[i]);
+        }
+    }
+    sp -= argc + 1;
+
+    S_Chunk *body = (S_Chunk*)proc->val.closure.body;
+    if (is_tail) {
+        // 复用当前帧：尾调用不增长帧栈
+        f->chunk = body;
+        f->ip = 0;
+        f->env = call_env;
+    } else {
+        if (fp + 1 == VM_FRAMES_MAX) {
+            fprintf(stderr, "Error: vm frame stack overflow\n");
+            exit(1);
+        }
+        f = &frames[++fp];
+        *f = (VM_Frame){ body, 0, call_env, sp };
+    }
+    NEXT;
+}
+
+do_return: {
+    S_Object *result = stack[--sp];
+    if (fp == base_fp) {
+        vm_sp = base_sp; // 回到进入时的水位
+        vm_fp = base_fp;
+        return result;
+    }
+    sp = f->base;
+    f = &frames[--fp];
+    PUSH(result);
+    NEXT;
+}
+    #undef NEXT
+    #undef OPERAND
+    #undef PUSH
+}
+
+// 原语回调 VM 闭包（vector-map 等）：绑定帧后重入 vm_run
+S_Object *scheme_vm_apply(S_Object *proc, S_Object **argv, int argc) {
+    S_Env *call_env;
+    S_Object *p = proc->val.closure.params;
+    if (argc <= S_ENV_SMALL_CAP) {
+        call_env = s_env_frame(proc->val.closure.env, argc);
+        int i = 0;
+        for (; i < argc && s_type(p) != S_NIL; i++, p = s_cdr(p)) {
+            call_env->syms[i] = s_car(p);
+            call_env->vals[i] = argv[i];
+            call_env->count++;
+        }
+        // 实参多于形参时清空余下槽位，同 do_call
+        for (; i < argc; i++) call_env->syms[i] = NULL;
+    } else {
+        call_env = s_env_new(proc->val.closure.env);
+        for (int i = 0; i < argc && s_type(p) != S_NIL; i++, p = s_cdr(p)) {
+            s_env_bind(call_env, s_car(p), argv[i]);
+        }
+    }
+    return vm_run((S_Chunk*)proc->val.closure.body, call_env);
+}
+
+// GC 钩子：标记 chunk 图里被引用的 lambda 参数列表
+// （常量池只含立即数和驻留符号，无需标记）
+void scheme_vm_mark_chunk(void *chunk) {
+    S_Chunk *c = chunk;
+    for (int i = 0; i < c->sub_len; i++) {
+        s_gc_mark(c->sub_params[i]);
+        scheme_vm_mark_chunk(c->subs[i]);
+    }
+}
+
+// 编译并执行一个 toplevel 表达式
+S_Object *scheme_vm_eval(S_Object *expr, S_Env *env) {
+    S_Chunk *c = chunk_new();
+    compile_expr(c, expr, 0);
+    chunk_emit(c, OP_RETURN);
+    long before = vm_closures_made;
+    S_Object *result = vm_run(c, env);
+    // 运行期间没创建过闭包就没有谁引用本 chunk 树，立即释放；
+    // 否则保守地随闭包存活（典型是 define 的 lambda，本就常驻）
+    if (vm_closures_made == before) chunk_free(c);
+    return result;
+}
@@ -0,0 +1,124 @@
+#include "scheme.h"
+
+// 带缓冲的输出层：scheme_print 渲染进 64KB 缓冲区，满了整块 fwrite
+// 到 stdout，取代旧的逐原子/逐括号 printf——大列表结果不再把时间耗在
+// stdio 加锁和格式串解析上。首次使用时注册 atexit 冲刷，错误路径的
+// exit(1) 也不会丢输出。
+
+#define OUT_BUF_SIZE 65536
+
+static _Thread_local char out_buf[OUT_BUF_SIZE];
+static _Thread_local size_t out_len = 0;
+static _Thread_local int out_registered = 0;
+
+void scheme_write_flush(void) {
+    if (out_len) {
+        fwrite(out_buf, 1, out_len, stdout);
+        out_len = 0;
+    }
+}
+
+static void out_need(size_t n) {
+    if (!out_registered) {
+        atexit(scheme_write_flush);
+        out_registered = 1;
+    }
+    if (out_len + n > OUT_BUF_SIZE) scheme_write_flush();
+}
+
+static void out_str(const char *s, size_t n) {
+    if (n > OUT_BUF_SIZE) { // 超长串直接写出，不经缓冲
+        scheme_write_flush();
+        fwrite(s, 1, n, stdout);
+        return;
+    }
+    out_need(n);
+    memcpy(out_buf + out_len, s, n);
+    out_len += n;
+}
+
+static void out_char(char ch) {
+    out_need(1);
+    out_buf[out_len++] = ch;
+}
+
+void scheme_write(const char *s) {
+    out_str(s, strlen(s));
+}
+
+// 数字：整数值（结果里占绝大多数）手写十进制；范围限制在 %g 也会
+// 以普通十进制打印的区间内，输出与旧格式逐字节一致。其余退回 %g。
+static void out_number(double d) {
+    long long v = (long long)d;
+    if ((double)v == d && d > -1e6 && d < 1e6) {
+        char tmp[24];
+        char *p = tmp + sizeof(tmp);
+        int neg = v < 0;
+        unsigned long long u = neg ? (unsigned long long)-v : (unsigned long long)v;
+        do {
+            *--p = (char)('0' + u % 10);
+            u /= 10;
+        } while (u);
+        if (neg) *--p = '-';
+        out_str(p, (size_t)(tmp + sizeof(tmp) - p));
+    } else {
+        char tmp[32];
+        int n = snprintf(tmp, sizeof(tmp), "%g", d);
+        out_str(tmp, (size_t)n);
+    }
+}
+
+void scheme_print(S_Object *obj) {
+    if (!obj) return;
+
+    switch (s_type(obj)) {
+        case S_NUMBER:
+            out_number(s_num_val(obj));
+            break;
+        case S_BOOL:
+            out_str(s_bool_val(obj) ? "#t" : "#f", 2);
+            break;
+        case S_SYMBOL:
+            scheme_write(s_sym_name(obj));
+            break;
+        case S_PAIR: {
+            out_char('(');
+            scheme_print(s_car(obj));
+            S_Object *cdr = s_cdr(obj);
+            while (s_type(cdr) == S_PAIR) {
+                out_char(' ');
+                scheme_print(s_car(cdr));
+                cdr = s_cdr(cdr);
+            }
+            if (s_type(cdr) != S_NIL) {
+                out_str(" . ", 3);
+                scheme_print(cdr);
+            }
+            out_char(')');
+            break;
+        }
+        case S_NIL:
+            out_str("()", 2);
+            break;
+        case S_VECTOR: {
+            out_str("#(", 2);
+            double *data = s_vec_data(obj);
+            for (int i = 0; i < s_vec_len(obj); i++) {
+                if (i) out_char(' ');
+                out_number(data[i]);
+            }
+            out_char(')');
+            break;
+        }
+        case S_PROC:
+            scheme_write("#<procedure>");
+            break;
+        case S_CLOSURE:
+        case S_VMCLOSURE:
+            scheme_write("#<closure>");
+            break;
+        case S_MEMO:
+            scheme_write("#<memoized>");
+            break;
+    }
+}
@@ -1,5 +1,8 @@
 import subprocess
 import argparse
+import json
+import os
+import time
 
 INTERPRETER_CONFIG = {
     "python": {
@@ -28,6 +31,27 @@ TEST_CONFIG = {
     "recursion": "tests/recursion.ss",
 }
 
+BENCH_CONFIG = {
+    "arith_loop": "bench/arith_loop.ss",
+    "deep_recursion": "bench/deep_recursion.ss",
+    "closure_storm": "bench/closure_storm.ss",
+    "env_lookup": "bench/env_lookup.ss",
+}
+
+# Features only the C interpreter has (vectors, memoize, fixnum
+# boundaries); each file must give the same answers from the tree
+# walker, the bytecode VM (--vm) and a precompiled .ssc image (-c).
+C_TEST_CONFIG = {
+    "c_vector": "tests/c_vector.ss",
+    "c_memoize": "tests/c_memoize.ss",
+    "c_fixnum": "tests/c_fixnum.ss",
+}
+
+BENCH_BASELINE_FILE = "bench/baseline.json"
+BENCH_REPEATS = 3           # best-of-N wall time to damp scheduler noise
+BENCH_TIME_THRESHOLD = 1.5  # fail if slower than baseline by more than 50%
+BENCH_RSS_THRESHOLD = 1.3   # fail if peak RSS grows by more than 30%
+
 
 class TestCase:
     def __init__(self, expression: str, expected: str):
@@ -62,36 +86,104 @@ RED='\033[0;31m'
 GREEN='\033[0;32m'
 NC='\033[0m'
 
+
+def run_measured(command: str):
+    """Run a benchmark once, returning (wall_time_s, max_rss_kb)."""
+    start = time.perf_counter()
+    proc = subprocess.Popen(command, shell=True, stdout=subprocess.DEVNULL)
+    _, status, rusage = os.wait4(proc.pid, 0)
+    elapsed = time.perf_counter() - start
+    proc.returncode = status  # already reaped; keep Popen from waiting again
+    if status != 0:
+        print(f"{RED}Benchmark command failed: {command}{NC}")
+        raise SystemExit(1)
+    return elapsed, rusage.ru_maxrss
+
+
+def run_benchmarks(config, update_baseline: bool) -> bool:
+    baseline = {}
+    if os.path.exists(BENCH_BASELINE_FILE):
+        with open(BENCH_BASELINE_FILE) as f:
+            baseline = json.load(f)
+
+    results = {}
+    ok = True
+    for bench_name, bench_file in BENCH_CONFIG.items():
+        command = f"{config['run_command']} {bench_file}"
+        best_time, max_rss = min(run_measured(command) for _ in range(BENCH_REPEATS))
+        results[bench_name] = {"time_s": round(best_time, 4), "max_rss_kb": max_rss}
+        line = f"{bench_name:16s} {best_time:8.3f}s  {max_rss:8d} KB"
+
+        base = baseline.get(bench_name)
+        if base is None or update_baseline:
+            print(f"{line}  (no baseline)" if base is None else line)
+            continue
+        time_ratio = best_time / base["time_s"]
+        rss_ratio = max_rss / base["max_rss_kb"]
+        if time_ratio > BENCH_TIME_THRESHOLD or rss_ratio > BENCH_RSS_THRESHOLD:
+            print(f"{RED}{line}  REGRESSION (time x{time_ratio:.2f}, rss x{rss_ratio:.2f}){NC}")
+            ok = False
+        else:
+            print(f"{GREEN}{line}  (time x{time_ratio:.2f}, rss x{rss_ratio:.2f}){NC}")
+
+    if update_baseline:
+        with open(BENCH_BASELINE_FILE, "w") as f:
+            json.dump(results, f, indent=2)
+            f.write("\n")
+        print(f"Baseline written to {BENCH_BASELINE_FILE}")
+    return ok
+
+
 if __name__ == "__main__":
     parser = argparse.ArgumentParser(description="Run tests for Scheme interpreter")
     parser.add_argument("-i", "--interpreter", choices=["python", "c", "typescript", "go"], default="python", help="Interpreter to use")
+    parser.add_argument("--bench", action="store_true", help="Run benchmarks instead of tests")
+    parser.add_argument("--bench-update", action="store_true", help="Run benchmarks and rewrite the baseline")
     args = parser.parse_args()
-    
+
     config = INTERPRETER_CONFIG[args.interpreter]
     if config["compile_command"]:
         subprocess.run(config["compile_command"], shell=True, check=True)
-    
-    for test_name, test_file in TEST_CONFIG.items():
+
+    if args.bench or args.bench_update:
+        if not run_benchmarks(config, args.bench_update):
+            raise SystemExit(1)
+        raise SystemExit(0)
+
+    def run_test(test_name, command, test_file):
         print(f"Running test: {test_name}")
         tests = load_tests_from_file(test_file)
-        print(f"Run command: {config['run_command']} {test_file}")
-        result = subprocess.run(f"{config['run_command']} {test_file}", shell=True, capture_output=True, text=True)
+        print(f"Run command: {command}")
+        result = subprocess.run(command, shell=True, capture_output=True, text=True)
         if result.returncode != 0:
             print(f"{RED}Test {test_name} failed: {result.stderr}{NC}")
-            continue
-        
+            return
+
         output = result.stdout.strip()
         for i, test in enumerate(tests):
             expected = test.expected
             actual = output.splitlines()[i]
-            
+
             if is_float(expected) and is_float(actual):
                 expected = float(expected)
                 actual = float(actual)
-                
+
             if expected != actual:
                 print(f"{RED}Test {test_name} failed on expression: {test.expression}{NC}")
                 print(f"  Expected: {expected}, Actual: {actual}\n")
                 break
         else:
-            print(f"{GREEN}Test {test_name} passed{NC}")
\ No newline at end of file
+            print(f"{GREEN}Test {test_name} passed{NC}")
+
+    for test_name, test_file in TEST_CONFIG.items():
+        run_test(test_name, f"{config['run_command']} {test_file}", test_file)
+
+    if args.interpreter == "c":
+        run = config["run_command"]
+        for test_name, test_file in C_TEST_CONFIG.items():
+            run_test(f"{test_name}[tree]", f"{run} {test_file}", test_file)
+            run_test(f"{test_name}[vm]", f"{run} --vm {test_file}", test_file)
+            image = test_file[:-len(".ss")] + ".ssc"
+            subprocess.run(f"{run} -c {test_file}", shell=True, check=True)
+            run_test(f"{test_name}[image]", f"{run} {image}", test_file)
+            os.remove(image)
\ No newline at end of file